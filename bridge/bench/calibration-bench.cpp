@@ -0,0 +1,134 @@
+//
+//  calibration-bench.cpp
+//  bridge
+//
+//  Times the PoseSolver tiers on the point sets of saved calibrations and
+//  reports their reprojection errors. The warm and locked tiers re-solve
+//  after one point moved a pixel, the way dragging a point does.
+//
+
+#include "PoseSolver.hpp"
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct PointSet {
+    std::string path;
+    std::vector<cv::Point3f> objectPoints;
+    std::vector<cv::Point2f> imagePoints;
+    cv::Size imageSize;
+};
+
+static bool loadPointSet(const std::string & path, PointSet & set){
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if(!fs.isOpened()) return false;
+    cv::Mat objectPoints, imagePoints;
+    fs["objectPoints"] >> objectPoints;
+    fs["imagePoints"] >> imagePoints;
+    fs["imageSize"][0] >> set.imageSize.width;
+    fs["imageSize"][1] >> set.imageSize.height;
+    if(objectPoints.type() != CV_32FC3 || imagePoints.type() != CV_32FC2 || objectPoints.total() != imagePoints.total()) return false;
+    objectPoints.reshape(3, 1).copyTo(set.objectPoints);
+    imagePoints.reshape(2, 1).copyTo(set.imagePoints);
+    set.path = path;
+    return true;
+}
+
+// median milliseconds of a number of runs
+static double timeMedian(int runs, const std::function<void()> & run){
+    std::vector<double> times(runs);
+    for(auto & time : times){
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::nth_element(times.begin(), times.begin() + runs / 2, times.end());
+    return times[runs / 2];
+}
+
+int main(int argc, char ** argv){
+
+    int runs = 100;
+    std::vector<std::string> paths;
+    for(int i = 1; i < argc; i++){
+        const std::string arg = argv[i];
+        if(arg == "--runs" && i + 1 < argc){
+            runs = std::max(1, atoi(argv[++i]));
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if(paths.empty()){
+        std::fprintf(stderr, "usage: calibration-bench [--runs n] calibrations/*/calibration-advanced.yml\n");
+        return 1;
+    }
+
+    // what Mapamok starts with
+    const int flags = cv::CALIB_USE_INTRINSIC_GUESS | cv::CALIB_FIX_ASPECT_RATIO | cv::CALIB_FIX_K1 | cv::CALIB_FIX_K2 | cv::CALIB_FIX_K3 | cv::CALIB_ZERO_TANGENT_DIST;
+
+    int failed = 0;
+    for(auto & path : paths){
+        PointSet set;
+        if(!loadPointSet(path, set)){
+            std::fprintf(stderr, "%s: no point set\n", path.c_str());
+            failed++;
+            continue;
+        }
+        std::printf("%s: %d points, %dx%d\n", path.c_str(), int(set.objectPoints.size()), set.imageSize.width, set.imageSize.height);
+        std::printf("  %-8s %9s %9s\n", "tier", "ms", "error px");
+
+        auto print = [](const char * name, double ms, double error){
+            std::printf("  %-8s %9.3f %9.3f\n", name, ms, error);
+        };
+
+        // the old way, calibrateCamera from an 80 degree guess
+        PoseSolver::Result guessed;
+        guessed.imageSize = set.imageSize;
+        const double guessMs = timeMedian(runs, [&]{
+            cv::Mat1d cameraMatrix = PoseSolver::guess(set.imageSize);
+            PoseSolver::calibrate(set.objectPoints, set.imagePoints, set.imageSize, flags, cameraMatrix, guessed.rvec, guessed.tvec);
+            guessed.cameraMatrix = cameraMatrix;
+        });
+        print("guess", guessMs, PoseSolver::reprojectionError(set.objectPoints, set.imagePoints, guessed));
+
+        PoseSolver::Result linear;
+        bool linearOk = false;
+        const double dltMs = timeMedian(runs, [&]{
+            cv::Mat1d cameraMatrix;
+            linearOk = PoseSolver::dlt(set.objectPoints, set.imagePoints, cameraMatrix, linear.rvec, linear.tvec);
+            linear.cameraMatrix = cameraMatrix;
+        });
+        if(linearOk){
+            print("dlt", dltMs, PoseSolver::reprojectionError(set.objectPoints, set.imagePoints, linear));
+        } else {
+            std::printf("  %-8s degenerate points\n", "dlt");
+        }
+
+        PoseSolver::Result cold;
+        const double coldMs = timeMedian(runs, [&]{
+            cold = PoseSolver::solve(set.objectPoints, set.imagePoints, set.imageSize, flags);
+        });
+        print(PoseSolver::getTierName(cold.tier), coldMs, cold.error);
+
+        auto moved = set.imagePoints;
+        moved[0].x += 1;
+
+        PoseSolver::Result warm;
+        const double warmMs = timeMedian(runs, [&]{
+            warm = PoseSolver::solve(set.objectPoints, moved, set.imageSize, flags, &cold);
+        });
+        print("warm", warmMs, warm.error);
+
+        PoseSolver::Result locked;
+        const double lockedMs = timeMedian(runs, [&]{
+            locked = PoseSolver::solve(set.objectPoints, moved, set.imageSize, flags, &cold, true);
+        });
+        print("locked", lockedMs, locked.error);
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+//
+//  calibration-store-bench.cpp
+//  bridge
+//
+//  Compares loading a projector from calibration-advanced.yml and
+//  reference-points.json, the way Mapamok and SelectablePoints read them, with
+//  loading the same calibration from a CalibrationRecord, and the file sizes.
+//
+
+#include "CalibrationRecord.hpp"
+#include <opencv2/core/core.hpp>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static bool loadYaml(const std::string & path, CalibrationRecord & record){
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if(!fs.isOpened()) return false;
+    cv::Mat objectPoints, imagePoints, cameraMatrix, rvec, tvec;
+    fs["objectPoints"] >> objectPoints;
+    fs["imagePoints"] >> imagePoints;
+    fs["cameraMatrix"] >> cameraMatrix;
+    fs["imageSize"][0] >> record.imageWidth;
+    fs["imageSize"][1] >> record.imageHeight;
+    fs["rotationVector"] >> rvec;
+    fs["translationVector"] >> tvec;
+    if(objectPoints.type() != CV_32FC3 || imagePoints.type() != CV_32FC2 || objectPoints.total() != imagePoints.total()) return false;
+    if(cameraMatrix.total() != 9 || rvec.total() != 3 || tvec.total() != 3) return false;
+    record.objectPoints.resize(objectPoints.total());
+    record.imagePoints.resize(imagePoints.total());
+    objectPoints.reshape(3, 1).copyTo(cv::Mat(1, int(objectPoints.total()), CV_32FC3, record.objectPoints.data()));
+    imagePoints.reshape(2, 1).copyTo(cv::Mat(1, int(imagePoints.total()), CV_32FC2, record.imagePoints.data()));
+    cameraMatrix.reshape(1, 1).convertTo(cv::Mat(1, 9, CV_64F, record.cameraMatrix), CV_64F);
+    rvec.reshape(1, 1).convertTo(cv::Mat(1, 3, CV_64F, record.rvec), CV_64F);
+    tvec.reshape(1, 1).convertTo(cv::Mat(1, 3, CV_64F, record.tvec), CV_64F);
+    record.calibrated = true;
+    return true;
+}
+
+// only the layout SelectablePoints::save writes, {"points":[{"hit":..,"x":..,"y":..},..]}
+static bool loadJson(const std::string & path, CalibrationRecord & record){
+    std::ifstream file(path);
+    if(!file) return false;
+    std::stringstream stream;
+    stream << file.rdbuf();
+    const std::string text = stream.str();
+    record.referencePoints.clear();
+    size_t at = 0;
+    while((at = text.find("\"hit\":", at)) != std::string::npos){
+        CalibrationRecord::ReferencePoint point;
+        at += 6;
+        point.hit = text.compare(at, 4, "true") == 0;
+        const size_t x = text.find("\"x\":", at);
+        const size_t y = text.find("\"y\":", at);
+        if(x == std::string::npos || y == std::string::npos) return false;
+        point.x = std::strtof(text.c_str() + x + 4, nullptr);
+        point.y = std::strtof(text.c_str() + y + 4, nullptr);
+        record.referencePoints.push_back(point);
+    }
+    return true;
+}
+
+static long fileSize(const std::string & path){
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file ? long(file.tellg()) : -1;
+}
+
+// median microseconds of a number of runs
+static double timeMedian(int runs, const std::function<void()> & run){
+    std::vector<double> times(runs);
+    for(auto & time : times){
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::nth_element(times.begin(), times.begin() + runs / 2, times.end());
+    return times[runs / 2];
+}
+
+int main(int argc, char ** argv){
+
+    int runs = 200;
+    std::vector<std::string> directories;
+    for(int i = 1; i < argc; i++){
+        const std::string arg = argv[i];
+        if(arg == "--runs" && i + 1 < argc){
+            runs = std::max(1, atoi(argv[++i]));
+        } else {
+            directories.push_back(arg);
+        }
+    }
+    if(directories.empty()){
+        std::fprintf(stderr, "usage: calibration-store-bench [--runs n] calibrations/*\n");
+        return 1;
+    }
+
+    const std::string recordPath = "/tmp/calibration-store-bench-" + std::to_string(getpid()) + ".bin";
+
+    int failed = 0;
+    for(auto & directory : directories){
+        const std::string yamlPath = directory + "/calibration-advanced.yml";
+        const std::string jsonPath = directory + "/reference-points.json";
+
+        CalibrationRecord imported;
+        if(!loadYaml(yamlPath, imported) || !loadJson(jsonPath, imported) || !imported.save(recordPath)){
+            std::fprintf(stderr, "%s: no calibration\n", directory.c_str());
+            failed++;
+            continue;
+        }
+
+        const double textUs = timeMedian(runs, [&]{
+            CalibrationRecord record;
+            loadYaml(yamlPath, record);
+            loadJson(jsonPath, record);
+        });
+        const double recordUs = timeMedian(runs, [&]{
+            CalibrationRecord record;
+            record.load(recordPath);
+        });
+
+        std::printf("%s: %d points, %d reference points\n", directory.c_str(), int(imported.objectPoints.size()), int(imported.referencePoints.size()));
+        std::printf("  %-12s %9s %9s\n", "format", "us", "bytes");
+        std::printf("  %-12s %9.1f %9ld\n", "yml + json", textUs, fileSize(yamlPath) + fileSize(jsonPath));
+        std::printf("  %-12s %9.1f %9ld\n", "record", recordUs, fileSize(recordPath));
+    }
+    unlink(recordPath.c_str());
+    return failed == 0 ? 0 : 1;
+}
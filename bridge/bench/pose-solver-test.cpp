@@ -0,0 +1,72 @@
+//
+//  pose-solver-test.cpp
+//  bridge
+//
+//  Checks that what the calibration flags keep fixed holds in every tier,
+//  also when the previous calibration was solved with other flags.
+//
+
+#include "PoseSolver.hpp"
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char * what){
+    if(!ok){
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static bool near(double a, double b){
+    return std::fabs(a - b) <= 1e-6 * std::max(1.0, std::fabs(b));
+}
+
+int main(){
+    const cv::Size imageSize(1920, 1200);
+
+    // a projector with square pixels and the principal point in the middle
+    const cv::Mat1d cameraMatrix = (cv::Mat1d(3, 3) <<
+                                    1800, 0, imageSize.width / 2.0,
+                                    0, 1800, imageSize.height / 2.0,
+                                    0, 0, 1);
+    const cv::Mat rvec = (cv::Mat1d(3, 1) << 0.1, -0.2, 0.05);
+    const cv::Mat tvec = (cv::Mat1d(3, 1) << 0.3, -0.1, 4.0);
+    std::vector<cv::Point3f> objectPoints;
+    for(int i = 0; i < 12; i++){
+        objectPoints.push_back(cv::Point3f((i % 4) * 0.5f - 0.75f, (i / 4) * 0.5f - 0.5f, (i % 3) * 0.3f));
+    }
+    std::vector<cv::Point2f> imagePoints;
+    cv::projectPoints(objectPoints, rvec, tvec, cameraMatrix, cv::noArray(), imagePoints);
+
+    const int fixedFlags = cv::CALIB_FIX_K1 | cv::CALIB_FIX_K2 | cv::CALIB_FIX_K3 | cv::CALIB_ZERO_TANGENT_DIST;
+
+    // solved without the principal point or aspect ratio fixed
+    PoseSolver::Result previous = PoseSolver::solve(objectPoints, imagePoints, imageSize, fixedFlags);
+    check(previous.ready, "cold solve");
+    previous.cameraMatrix = (cv::Mat1d(3, 3) <<
+                             1500, 0, 800,
+                             0, 1700, 500,
+                             0, 0, 1);
+
+    const int flags = fixedFlags | cv::CALIB_FIX_PRINCIPAL_POINT | cv::CALIB_FIX_ASPECT_RATIO;
+    const PoseSolver::Result warm = PoseSolver::solve(objectPoints, imagePoints, imageSize, flags, &previous);
+    const cv::Mat1d K = warm.cameraMatrix;
+    check(warm.ready && warm.tier == PoseSolver::WARM, "warm start");
+    check(near(K(0, 2), imageSize.width / 2.0) && near(K(1, 2), imageSize.height / 2.0), "warm start keeps the principal point centred");
+    check(near(K(0, 0), K(1, 1)), "warm start keeps the pixels square");
+    check(warm.error < 0.5, "warm start fits the points");
+
+    const PoseSolver::Result cold = PoseSolver::solve(objectPoints, imagePoints, imageSize, flags);
+    const cv::Mat1d coldK = cold.cameraMatrix;
+    check(cold.ready, "cold solve with fixed principal point and aspect ratio");
+    check(near(coldK(0, 2), imageSize.width / 2.0) && near(coldK(1, 2), imageSize.height / 2.0), "cold solve keeps the principal point centred");
+    check(near(coldK(0, 0), coldK(1, 1)), "cold solve keeps the pixels square");
+
+    if(failures == 0) std::printf("pose-solver-test: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+#version 150
+
+uniform mat4 modelViewProjectionMatrix;
+uniform vec4 globalColor;
+
+in vec4  position;
+in float label;
+
+out vec4 colorVarying;
+
+// the labels MeshTracker gives points, and 4 for the coarse points around them
+const vec4 labelColors[5] = vec4[5](
+    vec4(0.827, 0.827, 0.827, 1.), // lightGray, near no head
+    vec4(0.,    1.,    1.,    1.), // cyan
+    vec4(0.,    1.,    0.,    1.), // green
+    vec4(0.275, 0.510, 0.706, 1.), // blueSteel
+    vec4(0.412, 0.412, 0.412, 1.)  // dimGray
+);
+
+void main() {
+    gl_Position = modelViewProjectionMatrix * position;
+    colorVarying = labelColors[clamp(int(label), 0, 4)];
+    colorVarying.a *= globalColor.a;
+}
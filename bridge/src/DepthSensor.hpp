@@ -0,0 +1,215 @@
+//
+//  DepthSensor.hpp
+//  bridge
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "DepthSource.hpp"
+#include "DepthPreFilter.hpp"
+#include "HeadPipeline.hpp"
+#include "DepthPyramid.hpp"
+#include "TripleBuffer.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// A filtered depth frame and its pyramid, handed from a sensor to the tracking thread.
+struct SensorFrame {
+    vector<uint16_t> depth;
+    rs2_intrinsics intrinsics;
+    DepthPyramid pyramid;
+    float depthScale = 0.001;
+    unsigned long long frameNumber = 0;
+    double deviceTimestamp = 0.0; // ms, on the sensor's own clock
+    float hostTime = 0.0; // ofGetElapsedTimef() when the frame arrived
+    uint64_t arrivalMicros = 0; // ofGetElapsedTimeMicros() when the frame arrived
+    uint64_t filteredMicros = 0; // and when it was filtered
+    float captureLatency = -1; // ms from exposure to arrival, when the timestamps tell
+    bool globalTime = false; // deviceTimestamp is on the host clock shared by all sensors
+};
+
+// One depth camera or recording with a thread of its own, which waits for
+// frames, records them and runs the filter chain. Every sensor added to the
+// tracking brings its own core for this part.
+
+class DepthSensor {
+public:
+
+    // what a sensor reads from and where it is, see loadSensorConfigs
+    struct Config {
+        string source; // as for makeDepthSource
+        glm::vec3 position;
+        glm::vec3 rotation; // euler degrees, in world.origin space like pTrackingCameraPosition
+    };
+
+    ~DepthSensor(){
+        stop();
+    }
+
+    // onFrame is called on the sensor's thread after every published frame
+    bool setup(shared_ptr<DepthSource> source, int pyramidLevels, std::function<void()> onFrame){
+        this->source = source;
+        this->pyramidLevels = pyramidLevels;
+        this->onFrame = onFrame;
+        sourceOpen = source->open();
+        if(sourceOpen){
+            ofLogNotice("DepthSensor") << "reading from " << source->getDescription();
+        }
+
+        preFilter.setup(HeadPipeline::getFilterSettings());
+        return sourceOpen;
+    }
+
+    void start(){
+        if(running || !sourceOpen) return;
+        running = true;
+        thread = std::thread(&DepthSensor::threadedFunction, this);
+    }
+
+    void stop(){
+        running = false;
+        if(thread.joinable()){
+            thread.join();
+        }
+    }
+
+    bool isOpen() const {
+        return sourceOpen;
+    }
+
+    void setEnabled(bool e){
+        enabled = e;
+    }
+
+    const DepthSource * getSource() const {
+        return source.get();
+    }
+
+    // record unfiltered depth frames to a raw depth file, an empty path stops
+    void setRecording(string path){
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        recordingPath = path;
+        recordingRequested = true;
+    }
+
+    bool isRecording() const {
+        return recording;
+    }
+
+    // TRACKING THREAD
+
+    // fetch the latest filtered frame, returns true if it is new
+    bool update(){
+        return frameBuffer.update();
+    }
+
+    const SensorFrame & getFrame() const {
+        return frameBuffer.getReadBuffer();
+    }
+
+private:
+
+    void threadedFunction(){
+        while(running){
+            if(!enabled){
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+
+            // Get depth data from camera or recording
+            rs2::frame sourceFrame;
+            if(!source->waitForFrame(sourceFrame, 1000)){
+                continue;
+            }
+            auto & frame = frameBuffer.getWriteBuffer();
+            frame.hostTime = ofGetElapsedTimef();
+            frame.arrivalMicros = ofGetElapsedTimeMicros();
+            auto depth = sourceFrame.as<rs2::depth_frame>();
+
+            // global time stamps are on the system clock, so they tell how long the frame took to get here
+            frame.captureLatency = -1;
+            frame.globalTime = source->isLive() && depth.get_frame_timestamp_domain() == RS2_TIMESTAMP_DOMAIN_GLOBAL_TIME;
+            if(frame.globalTime){
+                const double nowMs = std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+                frame.captureLatency = nowMs - depth.get_timestamp();
+            }
+
+            updateRecording();
+            if(recorder.isOpen()){
+                recorder.write(depth);
+                recording = recorder.isOpen(); // stopped by a failed write
+            }
+
+            // decimation, spatial and temporal filtering in one go
+            auto depthIntrinsics = depth.get_profile().as<rs2::video_stream_profile>().get_intrinsics();
+            const auto & filtered = preFilter.process(reinterpret_cast<const uint16_t*>(depth.get_data()), depth.get_stride_in_bytes() / sizeof(uint16_t), depthIntrinsics, depth.get_frame_number(), depth.get_timestamp());
+            frame.depth = filtered.data;
+            frame.intrinsics = filtered.intrinsics;
+            frame.pyramid.build(frame.depth.data(), frame.intrinsics, pyramidLevels);
+            frame.depthScale = source->getDepthScale();
+            frame.frameNumber = depth.get_frame_number();
+            frame.deviceTimestamp = depth.get_timestamp();
+            frame.filteredMicros = ofGetElapsedTimeMicros();
+            frameBuffer.publish();
+            if(onFrame) onFrame();
+        }
+    }
+
+    void updateRecording(){
+        if(!recordingRequested) return;
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        recorder.close();
+        if(!recordingPath.empty()){
+            if(recorder.open(recordingPath, source->getIntrinsics(), source->getDepthScale(), source->getFps())){
+                ofLogNotice("DepthSensor") << "recording depth to " << recordingPath;
+            }
+        }
+        recording = recorder.isOpen();
+        recordingRequested = false;
+    }
+
+    shared_ptr<DepthSource> source;
+    bool sourceOpen = false;
+    int pyramidLevels = 0;
+    std::function<void()> onFrame;
+
+    DepthPreFilter preFilter;
+
+    RawDepthWriter recorder;
+    std::mutex recordingMutex;
+    string recordingPath;
+    std::atomic<bool> recordingRequested {false};
+    std::atomic<bool> recording {false};
+
+    TripleBuffer<SensorFrame> frameBuffer;
+
+    std::thread thread;
+    std::atomic<bool> running {false};
+    std::atomic<bool> enabled {false};
+};
+
+// The sensors after the first one, which is set up in pgTracking, from a file like
+//   { "sensors": [ { "source": "live:<serial>", "position": [x, y, z], "rotation": [x, y, z] } ] }
+// A missing file means there is just the one.
+inline vector<DepthSensor::Config> loadSensorConfigs(string path){
+    vector<DepthSensor::Config> configs;
+    if(!ofFile::doesFileExist(path)) return configs;
+    ofJson json = ofLoadJson(path);
+    if(!json.count("sensors")) return configs;
+    for(auto & entry : json["sensors"]){
+        DepthSensor::Config config;
+        config.source = entry.value("source", "");
+        if(entry.count("position")){
+            config.position = glm::vec3(entry["position"][0], entry["position"][1], entry["position"][2]);
+        }
+        if(entry.count("rotation")){
+            config.rotation = glm::vec3(entry["rotation"][0], entry["rotation"][1], entry["rotation"][2]);
+        }
+        configs.push_back(config);
+    }
+    return configs;
+}
@@ -0,0 +1,385 @@
+//
+//  DepthSource.hpp
+//  bridge
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include <librealsense2/rs.hpp>
+#include <librealsense2/hpp/rs_internal.hpp>
+#include "RawDepthFile.hpp"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// Where depth frames come from: a live RealSense, a rosbag recording or a
+// memory mapped raw depth file. All of them hand out ordinary rs2 depth
+// frames so the filter chain and the tracker do not care which one is used.
+
+class DepthSource {
+public:
+    virtual ~DepthSource(){}
+
+    virtual bool open() = 0;
+
+    // blocks until the next depth frame, returns false on timeout or end of data
+    virtual bool waitForFrame(rs2::frame & depth, unsigned int timeoutMs = 1000) = 0;
+
+    virtual string getDescription() const = 0;
+
+    // frames come from a camera right now, their timestamps can be compared to the clock
+    virtual bool isLive() const {
+        return false;
+    }
+
+    // recordings only: play at the recorded rate or as fast as frames are consumed
+    void setRealtime(bool r){
+        realtime = r;
+    }
+
+    bool isRealtime() const {
+        return realtime;
+    }
+
+    const rs2_intrinsics & getIntrinsics() const {
+        return intrinsics;
+    }
+
+    float getDepthScale() const {
+        return depthScale;
+    }
+
+    float getFps() const {
+        return fps;
+    }
+
+protected:
+    rs2_intrinsics intrinsics;
+    float depthScale = 0.001;
+    float fps = 60.0;
+    bool realtime = true;
+
+    void readStreamInfo(rs2::pipeline_profile & profile){
+        auto depth_sensor = profile.get_device().first<rs2::depth_sensor>();
+        depthScale = depth_sensor.get_depth_scale();
+
+        auto stream = profile.get_stream(RS2_STREAM_DEPTH);
+        fps = stream.fps();
+        if (auto video_stream = stream.as<rs2::video_stream_profile>())
+        {
+            try
+            {
+                intrinsics = video_stream.get_intrinsics();
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Failed to get intrinsics for the given stream. " << e.what() << std::endl;
+            }
+        }
+    }
+};
+
+// LIVE CAMERA
+
+class LiveDepthSource : public DepthSource {
+public:
+    rs2::pipeline pipe;
+    rs2::pipeline_profile selection;
+    string serial; // empty for the first camera found
+
+    LiveDepthSource(string serial = "") : serial(serial) {}
+
+    bool open() override {
+        try {
+            rs2::config cfg;
+            if(!serial.empty()){
+                cfg.enable_device(serial);
+            }
+            cfg.enable_stream(RS2_STREAM_DEPTH, 848, 480, RS2_FORMAT_ANY, 60);
+            selection = pipe.start(cfg);
+        } catch (const rs2::error & e) {
+            ofLogError("LiveDepthSource") << "could not start camera: " << e.what();
+            return false;
+        }
+
+        // Find first depth sensor (devices can have zero or more then one)
+        auto depth_sensor = selection.get_device().first<rs2::depth_sensor>();
+        if (depth_sensor.supports(RS2_OPTION_EMITTER_ENABLED))
+        {
+            depth_sensor.set_option(RS2_OPTION_EMITTER_ENABLED, 1.f); // Enable emitter
+        }
+        if (depth_sensor.supports(RS2_OPTION_ENABLE_AUTO_EXPOSURE))
+        {
+            depth_sensor.set_option(RS2_OPTION_ENABLE_AUTO_EXPOSURE, 1.f);
+        }
+        if (depth_sensor.supports(RS2_OPTION_LASER_POWER))
+        {
+            // Query min and max values:
+            auto range = depth_sensor.get_option_range(RS2_OPTION_LASER_POWER);
+            depth_sensor.set_option(RS2_OPTION_LASER_POWER, range.max); // Set max power
+        }
+
+        readStreamInfo(selection);
+        return true;
+    }
+
+    bool waitForFrame(rs2::frame & depth, unsigned int timeoutMs = 1000) override {
+        try {
+            depth = pipe.wait_for_frames(timeoutMs).get_depth_frame();
+        } catch (const rs2::error & e) {
+            ofLogWarning("LiveDepthSource") << e.what();
+            return false;
+        }
+        return true;
+    }
+
+    string getDescription() const override {
+        return serial.empty() ? "live camera" : "live camera " + serial;
+    }
+
+    bool isLive() const override {
+        return true;
+    }
+};
+
+// ROSBAG PLAYBACK
+
+class BagDepthSource : public DepthSource {
+public:
+    rs2::pipeline pipe;
+    rs2::pipeline_profile selection;
+    string path;
+
+    BagDepthSource(string path) : path(path) {}
+
+    bool open() override {
+        try {
+            rs2::config cfg;
+            cfg.enable_device_from_file(ofToDataPath(path, true), true);
+            selection = pipe.start(cfg);
+            selection.get_device().as<rs2::playback>().set_real_time(realtime);
+        } catch (const rs2::error & e) {
+            ofLogError("BagDepthSource") << "could not play " << path << ": " << e.what();
+            return false;
+        }
+        readStreamInfo(selection);
+        return true;
+    }
+
+    bool waitForFrame(rs2::frame & depth, unsigned int timeoutMs = 1000) override {
+        try {
+            depth = pipe.wait_for_frames(timeoutMs).get_depth_frame();
+        } catch (const rs2::error & e) {
+            ofLogWarning("BagDepthSource") << e.what();
+            return false;
+        }
+        return true;
+    }
+
+    string getDescription() const override {
+        return "bag " + path;
+    }
+};
+
+// RAW DEPTH FILES, see RawDepthFile.hpp for the format
+
+class RawDepthWriter {
+public:
+
+    ~RawDepthWriter(){
+        close();
+    }
+
+    bool open(string path, const rs2_intrinsics & intrinsics, float depthScale, float fps){
+        close();
+        file = fopen(ofToDataPath(path, true).c_str(), "wb");
+        if(file == nullptr){
+            ofLogError("RawDepthWriter") << "could not open " << path;
+            return false;
+        }
+        this->path = path;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, rawDepthMagic, sizeof(rawDepthMagic));
+        header.version = rawDepthVersion;
+        header.headerSize = sizeof(RawDepthHeader);
+        header.width = intrinsics.width;
+        header.height = intrinsics.height;
+        header.depthScale = depthScale;
+        header.fps = fps;
+        header.ppx = intrinsics.ppx;
+        header.ppy = intrinsics.ppy;
+        header.fx = intrinsics.fx;
+        header.fy = intrinsics.fy;
+        header.model = intrinsics.model;
+        for(int i = 0; i < 5; i++) header.coeffs[i] = intrinsics.coeffs[i];
+        if(fwrite(&header, sizeof(header), 1, file) != 1){
+            ofLogError("RawDepthWriter") << "could not write to " << path;
+            fclose(file);
+            file = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const {
+        return file != nullptr;
+    }
+
+    void write(const rs2::depth_frame & depth){
+        if(file == nullptr) return;
+        if(uint32_t(depth.get_width()) != header.width || uint32_t(depth.get_height()) != header.height) return;
+        RawDepthFrameHeader frameHeader;
+        frameHeader.timestamp = depth.get_timestamp();
+        frameHeader.frameNumber = depth.get_frame_number();
+        bool written = fwrite(&frameHeader, sizeof(frameHeader), 1, file) == 1;
+        const uint8_t * data = (const uint8_t*) depth.get_data();
+        for(uint32_t y = 0; y < header.height && written; y++){
+            written = fwrite(data + y * depth.get_stride_in_bytes(), sizeof(uint16_t), header.width, file) == header.width;
+        }
+        if(!written){
+            // the partial frame is left out of the frame count, so the file still plays
+            ofLogError("RawDepthWriter") << "could not write frame " << header.frameCount << " to " << path << ", recording stopped";
+            close();
+            return;
+        }
+        header.frameCount++;
+    }
+
+    void close(){
+        if(file == nullptr) return;
+        // frame count is only known now
+        if(fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1){
+            ofLogError("RawDepthWriter") << "could not write the frame count to " << path;
+        }
+        if(fclose(file) != 0){
+            ofLogError("RawDepthWriter") << "could not close " << path;
+        }
+        file = nullptr;
+    }
+
+private:
+    FILE * file = nullptr;
+    string path;
+    RawDepthHeader header;
+};
+
+// Plays a raw depth file straight out of a memory mapping. Frames are pushed
+// through a software device, so they point into the mapping without a copy.
+
+class RawDepthSource : public DepthSource {
+public:
+    string path;
+
+    RawDepthSource(string path) : path(path) {}
+
+    ~RawDepthSource(){
+        if(sensor){
+            sensor->stop();
+            sensor->close();
+        }
+    }
+
+    bool open() override {
+        if(!reader.open(ofToDataPath(path, true))){
+            ofLogError("RawDepthSource") << reader.getError();
+            return false;
+        }
+        const auto & header = reader.getHeader();
+        intrinsics = reader.getIntrinsics();
+        depthScale = header.depthScale;
+        fps = header.fps;
+
+        rs2_video_stream stream;
+        stream.type = RS2_STREAM_DEPTH;
+        stream.index = 0;
+        stream.uid = 0;
+        stream.width = header.width;
+        stream.height = header.height;
+        stream.fps = fps;
+        stream.bpp = sizeof(uint16_t);
+        stream.fmt = RS2_FORMAT_Z16;
+        stream.intrinsics = intrinsics;
+
+        sensor = make_shared<rs2::software_sensor>(device.add_sensor("Depth"));
+        profile = sensor->add_video_stream(stream);
+        sensor->add_read_only_option(RS2_OPTION_DEPTH_UNITS, depthScale);
+        sensor->open(profile);
+        sensor->start(queue);
+        return true;
+    }
+
+    bool waitForFrame(rs2::frame & depth, unsigned int timeoutMs = 1000) override {
+        if(frameIndex >= reader.getFrameCount()){
+            // loop like the bag playback does
+            frameIndex = 0;
+        }
+        auto frameHeader = reader.getFrame(frameIndex);
+
+        if(realtime){
+            auto now = std::chrono::steady_clock::now();
+            if(frameIndex == 0){
+                playbackStart = now;
+                firstTimestamp = frameHeader->timestamp;
+            }
+            auto due = playbackStart + std::chrono::microseconds((long long)((frameHeader->timestamp - firstTimestamp) * 1000.0));
+            if(due > now){
+                std::this_thread::sleep_until(due);
+            }
+        }
+
+        rs2_software_video_frame frame;
+        frame.pixels = (void*)RawDepthReader::getDepth(frameHeader);
+        frame.deleter = [](void*){}; // the mapping outlives the frame
+        frame.stride = reader.getHeader().width * sizeof(uint16_t);
+        frame.bpp = sizeof(uint16_t);
+        frame.timestamp = frameHeader->timestamp;
+        frame.domain = RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK;
+        frame.frame_number = frameHeader->frameNumber;
+        frame.profile = profile.get();
+        sensor->on_video_frame(frame);
+        frameIndex++;
+
+        try {
+            depth = queue.wait_for_frame(timeoutMs);
+        } catch (const rs2::error & e) {
+            ofLogWarning("RawDepthSource") << e.what();
+            return false;
+        }
+        return true;
+    }
+
+    string getDescription() const override {
+        return "raw " + path;
+    }
+
+    uint32_t getFrameCount() const {
+        return reader.getFrameCount();
+    }
+
+private:
+    RawDepthReader reader;
+    uint32_t frameIndex = 0;
+
+    rs2::software_device device;
+    shared_ptr<rs2::software_sensor> sensor;
+    rs2::stream_profile profile;
+    rs2::frame_queue queue;
+
+    std::chrono::steady_clock::time_point playbackStart;
+    double firstTimestamp = 0;
+};
+
+// empty path means live camera, "live:<serial>" a particular one, otherwise pick playback by file extension
+inline shared_ptr<DepthSource> makeDepthSource(string path){
+    if(path.empty()){
+        return make_shared<LiveDepthSource>();
+    }
+    if(path.compare(0, 5, "live:") == 0){
+        return make_shared<LiveDepthSource>(path.substr(5));
+    }
+    if(ofToLower(ofFilePath::getFileExt(path)) == "bag"){
+        return make_shared<BagDepthSource>(path);
+    }
+    return make_shared<RawDepthSource>(path);
+}
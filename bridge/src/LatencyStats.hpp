@@ -0,0 +1,110 @@
+//
+//  LatencyStats.hpp
+//  bridge
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Latency samples per pipeline stage, from the depth camera to the projectors.
+//
+// Every stage keeps its newest samples in a ring of its own. A stage is
+// recorded by one thread only, the tracking thread or the render thread, and
+// read by the GUI without locks; a sample overwritten while it is copied just
+// ends up in the next summary instead.
+
+class LatencyStats {
+public:
+
+    enum Stage {
+        CAPTURE, // camera exposure to arrival, live cameras with global timestamps only
+        FILTER, // arrival to filtered depth
+        TRACK, // filtered depth to updated heads
+        HANDOFF, // published by the tracking thread to picked up by the render thread
+        SMOOTH, // picked up to pHeadPosition set
+        VIEW, // pHeadPosition set to ViewPlane::begin
+        PROJECTOR, // ViewPlane::begin to the projector outputs drawn
+        TOTAL, // arrival to the projector outputs drawn
+        STAGE_COUNT
+    };
+
+    static const int capacity = 1024; // samples per stage
+
+    struct Summary {
+        size_t count = 0;
+        float p50 = 0;
+        float p95 = 0;
+        float p99 = 0;
+    };
+
+    static const char * getStageName(int stage){
+        static const char * names[STAGE_COUNT] = {"capture", "filter", "track", "handoff", "smooth", "view", "projector", "total"};
+        return names[stage];
+    }
+
+    // ms
+    void record(Stage stage, float latency){
+        Ring & ring = rings[stage];
+        const uint64_t index = ring.written.load(std::memory_order_relaxed);
+        ring.samples[index % capacity].store(latency, std::memory_order_relaxed);
+        ring.written.store(index + 1, std::memory_order_release);
+    }
+
+    Summary summarize(Stage stage) const {
+        Summary summary;
+        std::vector<float> sorted;
+        copySamples(stage, sorted);
+        summary.count = sorted.size();
+        if(sorted.empty()) return summary;
+        std::sort(sorted.begin(), sorted.end());
+        summary.p50 = percentile(sorted, 0.50);
+        summary.p95 = percentile(sorted, 0.95);
+        summary.p99 = percentile(sorted, 0.99);
+        return summary;
+    }
+
+    // one line per sample, oldest first per stage
+    bool saveCsv(const std::string & path) const {
+        std::ofstream file(path);
+        if(!file) return false;
+        file << "stage,sample,ms\n";
+        std::vector<float> samples;
+        for(int s = 0; s < STAGE_COUNT; s++){
+            copySamples(Stage(s), samples);
+            for(size_t i = 0; i < samples.size(); i++){
+                file << getStageName(s) << "," << i << "," << samples[i] << "\n";
+            }
+        }
+        return bool(file);
+    }
+
+private:
+
+    struct Ring {
+        std::atomic<float> samples[capacity];
+        std::atomic<uint64_t> written{0};
+    };
+
+    void copySamples(Stage stage, std::vector<float> & out) const {
+        const Ring & ring = rings[stage];
+        const uint64_t written = ring.written.load(std::memory_order_acquire);
+        const uint64_t count = std::min<uint64_t>(written, capacity);
+        out.resize(count);
+        for(uint64_t i = 0; i < count; i++){
+            out[i] = ring.samples[(written - count + i) % capacity].load(std::memory_order_relaxed);
+        }
+    }
+
+    static float percentile(const std::vector<float> & sorted, float p){
+        const size_t i = std::min(sorted.size() - 1, size_t(p * (sorted.size() - 1) + 0.5));
+        return sorted[i];
+    }
+
+    Ring rings[STAGE_COUNT];
+};
@@ -0,0 +1,119 @@
+//
+//  PointCloudBuffer.hpp
+//  bridge
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+// The tracking point cloud on the GPU, a position and a one byte label per
+// point, coloured by shaders/pointLabels.
+//
+// One buffer holds a few segments that are filled in turn through unsynchronized
+// mapped writes, with a fence so a segment is never written while a draw still
+// reads it. Persistent mapping would save the map calls but needs GL 4.4, the
+// app runs on 4.1. The buffer only grows, when the cloud does.
+
+class PointCloudBuffer {
+public:
+
+    static const int segments = 3;
+
+    ~PointCloudBuffer(){
+        for(auto & fence : fences){
+            if(fence) glDeleteSync(fence);
+        }
+        if(vao) glDeleteVertexArrays(1, &vao);
+    }
+
+    void upload(const vector<glm::vec3> & points, const vector<uint8_t> & labels){
+        count = std::min(points.size(), labels.size());
+        if(count == 0) return;
+        if(count > capacity){
+            allocate(count + count / 2);
+        }
+
+        current = (current + 1) % segments;
+        if(fences[current]){
+            glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1e9));
+            glDeleteSync(fences[current]);
+            fences[current] = 0;
+        }
+
+        const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        auto positions = (glm::vec3*)buffer.mapRange(positionOffset(current), count * sizeof(glm::vec3), access);
+        if(positions){
+            memcpy(positions, points.data(), count * sizeof(glm::vec3));
+            buffer.unmapRange();
+        }
+        auto labelBytes = (uint8_t*)buffer.mapRange(labelOffset(current), count, access);
+        if(labelBytes){
+            memcpy(labelBytes, labels.data(), count);
+            buffer.unmapRange();
+        }
+    }
+
+    // with the shader bound
+    void draw(ofShader & shader){
+        if(count == 0 || !vao) return;
+        // looked up every time, the shader reloads when it is edited
+        const GLint positionLocation = shader.getAttributeLocation("position");
+        const GLint labelLocation = shader.getAttributeLocation("label");
+        if(positionLocation < 0) return;
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer.getId());
+        glEnableVertexAttribArray(positionLocation);
+        glVertexAttribPointer(positionLocation, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)positionOffset(current));
+        if(labelLocation >= 0){
+            glEnableVertexAttribArray(labelLocation);
+            glVertexAttribPointer(labelLocation, 1, GL_UNSIGNED_BYTE, GL_FALSE, 1, (void*)labelOffset(current));
+        }
+        glDrawArrays(GL_POINTS, 0, count);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+
+        if(fences[current]) glDeleteSync(fences[current]);
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+private:
+
+    // a segment is capacity positions followed by capacity labels
+    size_t segmentBytes() const {
+        return capacity * (sizeof(glm::vec3) + 1);
+    }
+
+    size_t positionOffset(int segment) const {
+        return segment * segmentBytes();
+    }
+
+    size_t labelOffset(int segment) const {
+        return positionOffset(segment) + capacity * sizeof(glm::vec3);
+    }
+
+    void allocate(size_t points){
+        if(!vao) glGenVertexArrays(1, &vao);
+        for(auto & fence : fences){
+            if(fence){
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1e9));
+                glDeleteSync(fence);
+                fence = 0;
+            }
+        }
+        capacity = (points + 3) & ~size_t(3); // keeps the segments 4 byte aligned
+        buffer.allocate(segments * segmentBytes(), GL_STREAM_DRAW);
+    }
+
+    ofBufferObject buffer;
+    GLuint vao = 0;
+    GLsync fences[segments] = {};
+    size_t capacity = 0; // points per segment
+    size_t count = 0;
+    int current = 0;
+};
@@ -0,0 +1,113 @@
+//
+//  PosePredictor.hpp
+//  bridge
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Extrapolates a tracked position to the time a frame will be on screen.
+//
+// Velocity is a least squares fit over the last few samples against the depth
+// camera's own timestamps, which are free of the jitter in when frames reach
+// the app. Device time is mapped to host time by the smallest offset seen
+// recently, the frame that arrived with the least delay. Predictions never
+// reach further than maxExtrapolation past the newest sample, so a stalled
+// tracker makes the pose stop instead of drift away.
+
+class PosePredictor {
+public:
+
+    float maxExtrapolation = 0.15; // s
+
+    void reset(){
+        count = 0;
+        next = 0;
+    }
+
+    bool isValid() const {
+        return count > 0;
+    }
+
+    // position at deviceTimestamp (ms, as rs2 reports it), seen at hostTime (s)
+    void addSample(const glm::vec3 & position, double deviceTimestamp, double hostTime){
+        const double deviceTime = deviceTimestamp / 1000.0;
+        if(count > 0 && deviceTime <= samples[newest()].time){
+            // same or older frame, or the camera restarted
+            if(deviceTime < samples[newest()].time) reset();
+            else return;
+        }
+        samples[next].position = position;
+        samples[next].time = deviceTime;
+        samples[next].offset = hostTime - deviceTime;
+        next = (next + 1) % capacity;
+        count = std::min(count + 1, capacity);
+        fit();
+    }
+
+    // position at hostTime, for example the expected scanout of the frame being rendered
+    glm::vec3 predict(double hostTime) const {
+        if(count == 0) return glm::vec3(0);
+        const Sample & last = samples[newest()];
+        double deviceTime = hostTime - offset;
+        double dt = std::min(deviceTime - last.time, double(maxExtrapolation));
+        dt = std::max(dt, -double(maxExtrapolation));
+        return position + velocity * float(dt);
+    }
+
+private:
+
+    static const int capacity = 8;
+    static const int fitSamples = 4;
+
+    struct Sample {
+        glm::vec3 position;
+        double time;
+        double offset;
+    };
+
+    int newest() const {
+        return (next + capacity - 1) % capacity;
+    }
+
+    void fit(){
+        offset = samples[newest()].offset;
+        for(int i = 0; i < count; i++){
+            offset = std::min(offset, samples[i].offset);
+        }
+
+        // least squares line through the last samples, evaluated at the newest one
+        const int n = std::min(count, fitSamples);
+        double meanT = 0;
+        glm::dvec3 meanP(0);
+        for(int i = 0; i < n; i++){
+            const Sample & s = samples[(next + capacity - 1 - i) % capacity];
+            meanT += s.time;
+            meanP += glm::dvec3(s.position);
+        }
+        meanT /= n;
+        meanP /= double(n);
+        double varT = 0;
+        glm::dvec3 cov(0);
+        for(int i = 0; i < n; i++){
+            const Sample & s = samples[(next + capacity - 1 - i) % capacity];
+            const double dt = s.time - meanT;
+            varT += dt * dt;
+            cov += (glm::dvec3(s.position) - meanP) * dt;
+        }
+        const glm::dvec3 v = varT > 0 ? cov / varT : glm::dvec3(0);
+        velocity = glm::vec3(v);
+        position = glm::vec3(meanP + v * (samples[newest()].time - meanT));
+    }
+
+    Sample samples[capacity];
+    int count = 0;
+    int next = 0;
+
+    double offset = 0; // host time minus device time
+    glm::vec3 position;
+    glm::vec3 velocity;
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+//
+//  CalibrationRecord.hpp
+//  bridge
+//
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Everything a projector keeps between runs in one binary file: intrinsics,
+// pose, the point pairs it was solved from and the reference points.
+//
+// A fixed header with magic, version, size and a checksum over the rest,
+// followed by the body and the point arrays, in the byte order of the
+// machine that wrote it. Loading maps the file and checks it before anything
+// is copied out, saving writes a temporary file next to it and renames it over
+// the old one, so a crash never leaves half a calibration behind. No
+// openFrameworks or OpenCV, the benchmark in bridge/bench uses it too.
+
+static const char calibrationRecordMagic[4] = {'O','C','A','L'};
+
+class CalibrationRecord {
+public:
+
+    static const uint32_t version = 1;
+
+    struct Point2 {
+        float x, y;
+    };
+
+    struct Point3 {
+        float x, y, z;
+    };
+
+    struct ReferencePoint {
+        float x, y;
+        uint32_t hit;
+    };
+
+    bool calibrated = false;
+    int32_t imageWidth = 0;
+    int32_t imageHeight = 0;
+    double cameraMatrix[9] = {};
+    double rvec[3] = {};
+    double tvec[3] = {};
+    std::vector<Point3> objectPoints; // pairs with imagePoints
+    std::vector<Point2> imagePoints;
+    std::vector<ReferencePoint> referencePoints;
+
+    // false when the file is missing, from another version or damaged
+    bool load(const std::string & path){
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        struct stat st;
+        if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header) + sizeof(Body)){
+            ::close(fd);
+            return false;
+        }
+        const size_t size = st.st_size;
+        void * data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(data == MAP_FAILED) return false;
+        const bool ok = read((const uint8_t*)data, size);
+        munmap(data, size);
+        return ok;
+    }
+
+    bool save(const std::string & path) const {
+        const std::vector<uint8_t> bytes = write();
+        const std::string temporary = path + ".tmp";
+        const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) return false;
+        size_t written = 0;
+        while(written < bytes.size()){
+            const ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+            if(n <= 0) break;
+            written += n;
+        }
+        const bool ok = written == bytes.size() && fsync(fd) == 0;
+        if(::close(fd) != 0 || !ok || std::rename(temporary.c_str(), path.c_str()) != 0){
+            ::unlink(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // FNV-1a
+    static uint64_t checksum(const uint8_t * data, size_t size){
+        uint64_t hash = 14695981039346656037ull;
+        for(size_t i = 0; i < size; i++){
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+private:
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t size; // of the whole file
+        uint64_t checksum; // of everything after the header
+    };
+
+    struct Body {
+        uint32_t calibrated;
+        int32_t imageWidth;
+        int32_t imageHeight;
+        uint32_t pointCount;
+        double cameraMatrix[9];
+        double rvec[3];
+        double tvec[3];
+        uint32_t referencePointCount;
+        uint32_t reserved;
+    };
+
+    static_assert(std::is_trivially_copyable<Header>::value && std::is_trivially_copyable<Body>::value, "written as bytes");
+    static_assert(sizeof(Header) == 24 && sizeof(Body) == 144, "the file layout must not depend on the compiler");
+    static_assert(sizeof(Point3) == 12 && sizeof(Point2) == 8 && sizeof(ReferencePoint) == 12, "the file layout must not depend on the compiler");
+
+    std::vector<uint8_t> write() const {
+        const uint32_t pointCount = std::min(objectPoints.size(), imagePoints.size());
+        const size_t size = sizeof(Header) + sizeof(Body) + pointCount * (sizeof(Point3) + sizeof(Point2)) + referencePoints.size() * sizeof(ReferencePoint);
+        std::vector<uint8_t> bytes(size, 0);
+
+        Body body = {};
+        body.calibrated = calibrated;
+        body.imageWidth = imageWidth;
+        body.imageHeight = imageHeight;
+        body.pointCount = pointCount;
+        memcpy(body.cameraMatrix, cameraMatrix, sizeof(cameraMatrix));
+        memcpy(body.rvec, rvec, sizeof(rvec));
+        memcpy(body.tvec, tvec, sizeof(tvec));
+        body.referencePointCount = referencePoints.size();
+
+        uint8_t * cursor = bytes.data() + sizeof(Header);
+        memcpy(cursor, &body, sizeof(Body));
+        cursor += sizeof(Body);
+        memcpy(cursor, objectPoints.data(), pointCount * sizeof(Point3));
+        cursor += pointCount * sizeof(Point3);
+        memcpy(cursor, imagePoints.data(), pointCount * sizeof(Point2));
+        cursor += pointCount * sizeof(Point2);
+        memcpy(cursor, referencePoints.data(), referencePoints.size() * sizeof(ReferencePoint));
+
+        Header header;
+        memcpy(header.magic, calibrationRecordMagic, sizeof(header.magic));
+        header.version = version;
+        header.size = size;
+        header.checksum = checksum(bytes.data() + sizeof(Header), size - sizeof(Header));
+        memcpy(bytes.data(), &header, sizeof(Header));
+        return bytes;
+    }
+
+    bool read(const uint8_t * data, size_t size){
+        Header header;
+        memcpy(&header, data, sizeof(Header));
+        if(memcmp(header.magic, calibrationRecordMagic, sizeof(header.magic)) != 0 || header.version != version || header.size != size) return false;
+        if(header.checksum != checksum(data + sizeof(Header), size - sizeof(Header))) return false;
+
+        Body body;
+        memcpy(&body, data + sizeof(Header), sizeof(Body));
+        const size_t arrays = size_t(body.pointCount) * (sizeof(Point3) + sizeof(Point2)) + size_t(body.referencePointCount) * sizeof(ReferencePoint);
+        if(sizeof(Header) + sizeof(Body) + arrays != size) return false;
+
+        calibrated = body.calibrated != 0;
+        imageWidth = body.imageWidth;
+        imageHeight = body.imageHeight;
+        memcpy(cameraMatrix, body.cameraMatrix, sizeof(cameraMatrix));
+        memcpy(rvec, body.rvec, sizeof(rvec));
+        memcpy(tvec, body.tvec, sizeof(tvec));
+
+        const uint8_t * cursor = data + sizeof(Header) + sizeof(Body);
+        objectPoints.resize(body.pointCount);
+        memcpy(objectPoints.data(), cursor, body.pointCount * sizeof(Point3));
+        cursor += body.pointCount * sizeof(Point3);
+        imagePoints.resize(body.pointCount);
+        memcpy(imagePoints.data(), cursor, body.pointCount * sizeof(Point2));
+        cursor += body.pointCount * sizeof(Point2);
+        referencePoints.resize(body.referencePointCount);
+        memcpy(referencePoints.data(), cursor, body.referencePointCount * sizeof(ReferencePoint));
+        return true;
+    }
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+//
+//  CalibrationSolver.hpp
+//  bridge
+//
+
+#include "ofMain.h"
+#include "Mapamok.hpp"
+#include "TripleBuffer.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Runs Mapamok::solve on a thread of its own, so dragging reference points
+// never waits for calibrateCamera. Only the newest request is solved, the
+// ones that come in while a solve runs replace each other.
+
+class CalibrationSolver {
+public:
+
+    struct Request {
+        int width = 0;
+        int height = 0;
+        vector<ofVec2f> imagePoints;
+        vector<ofVec3f> objectPoints;
+        int flags = 0;
+        PoseSolver::Result previous; // warm start, Mapamok::getPose()
+        bool lockIntrinsics = false;
+    };
+
+    ~CalibrationSolver(){
+        {
+            std::lock_guard<std::mutex> lock(requestMutex);
+            running = false;
+        }
+        requestCondition.notify_one();
+        if(thread.joinable()){
+            thread.join();
+        }
+    }
+
+    void request(Request && r){
+        {
+            std::lock_guard<std::mutex> lock(requestMutex);
+            pending = std::move(r);
+            hasPending = true;
+            if(!thread.joinable()){
+                running = true;
+                thread = std::thread(&CalibrationSolver::threadedFunction, this);
+            }
+        }
+        requestCondition.notify_one();
+    }
+
+    // fetch the newest solution, returns true if it is new
+    bool update(){
+        return solutions.update();
+    }
+
+    const Mapamok::Solution & getSolution() const {
+        return solutions.getReadBuffer();
+    }
+
+    // a request is waiting or being solved
+    bool isSolving() const {
+        return busy;
+    }
+
+    // blocks until the last request is solved, fetch it with update()
+    void wait(){
+        std::unique_lock<std::mutex> lock(requestMutex);
+        idleCondition.wait(lock, [this]{ return !hasPending && !busy; });
+    }
+
+private:
+
+    void threadedFunction(){
+        Request current;
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(requestMutex);
+                requestCondition.wait(lock, [this]{ return hasPending || !running; });
+                if(!running) return;
+                current = std::move(pending);
+                hasPending = false;
+                busy = true;
+            }
+            solutions.getWriteBuffer() = Mapamok::solve(current.width, current.height, current.imagePoints, current.objectPoints, current.flags, &current.previous, current.lockIntrinsics);
+            solutions.publish();
+            std::lock_guard<std::mutex> lock(requestMutex);
+            busy = hasPending;
+            if(!busy) idleCondition.notify_all();
+        }
+    }
+
+    TripleBuffer<Mapamok::Solution> solutions;
+
+    std::thread thread;
+    std::mutex requestMutex;
+    std::condition_variable requestCondition;
+    std::condition_variable idleCondition;
+    Request pending;
+    bool hasPending = false;
+    bool running = false;
+    std::atomic<bool> busy {false};
+};
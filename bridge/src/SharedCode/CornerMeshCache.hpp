@@ -0,0 +1,81 @@
+#pragma once
+
+//
+//  CornerMeshCache.hpp
+//  bridge
+//
+
+#include "ofMain.h"
+#include <cstdio>
+
+// The calibration corners baked from the node model, kept on disk next to it.
+//
+// The key hashes the model file and every setting the bake depends on, a
+// cache with another key is baked again. Bump version when the bake itself
+// changes. The file is the key and the corners as floats, written to a
+// temporary file and renamed into place.
+
+class CornerMeshCache {
+public:
+
+    static const uint32_t version = 1;
+
+    static uint64_t key(const string & modelPath, const vector<float> & settings){
+        ofBuffer model = ofBufferFromFile(modelPath, true);
+        const uint32_t cacheVersion = version;
+        uint64_t hash = hashBytes(offsetBasis, &cacheVersion, sizeof(cacheVersion));
+        hash = hashBytes(hash, model.getData(), model.size());
+        return hashBytes(hash, settings.data(), settings.size() * sizeof(float));
+    }
+
+    static bool load(const string & path, uint64_t key, ofMesh & corners){
+        if(!ofFile::doesFileExist(path)) return false;
+        ofBuffer buffer = ofBufferFromFile(path, true);
+        Header header;
+        if(buffer.size() < sizeof(Header)) return false;
+        memcpy(&header, buffer.getData(), sizeof(Header));
+        if(memcmp(header.magic, magic(), 4) != 0 || header.key != key || buffer.size() != sizeof(Header) + header.count * sizeof(glm::vec3)) return false;
+        corners.clear();
+        corners.setMode(OF_PRIMITIVE_POINTS);
+        corners.getVertices().resize(header.count);
+        memcpy(corners.getVerticesPointer(), buffer.getData() + sizeof(Header), header.count * sizeof(glm::vec3));
+        return true;
+    }
+
+    static bool save(const string & path, uint64_t key, const ofMesh & corners){
+        Header header;
+        memcpy(header.magic, magic(), 4);
+        header.count = corners.getNumVertices();
+        header.key = key;
+        ofBuffer buffer;
+        buffer.append((const char*)&header, sizeof(Header));
+        buffer.append((const char*)corners.getVertices().data(), header.count * sizeof(glm::vec3));
+        const string temporary = path + ".tmp";
+        if(!ofBufferToFile(temporary, buffer, true)) return false;
+        return std::rename(ofToDataPath(temporary, true).c_str(), ofToDataPath(path, true).c_str()) == 0;
+    }
+
+private:
+
+    struct Header {
+        char magic[4];
+        uint32_t count;
+        uint64_t key;
+    };
+
+    static const char * magic(){
+        return "OCRN";
+    }
+
+    static const uint64_t offsetBasis = 14695981039346656037ull;
+
+    // FNV-1a
+    static uint64_t hashBytes(uint64_t hash, const void * data, size_t size){
+        const uint8_t * bytes = (const uint8_t*)data;
+        for(size_t i = 0; i < size; i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+};
@@ -2,6 +2,8 @@
 
 #include "ofMain.h"
 #include "ofxCv.h"
+#include "PoseSolver.hpp"
+#include "CalibrationRecord.hpp"
 
 class Mapamok {
 public:
@@ -12,6 +14,8 @@ public:
     vector<vector<cv::Point2f> > imagePointsCv = vector<vector<cv::Point2f> >(1);
     ofxCv::Intrinsics intrinsics;
     bool calibrationReady = false;
+    PoseSolver::Tier solveTier = PoseSolver::NONE; // how the calibration was last solved
+    double reprojectionError = 0; // rms pixels
     cv::Size2i imageSize;
     float nearClip = .1;
     float farClip = 10000.0;
@@ -24,52 +28,74 @@ public:
     ofParameter<bool> pCV_CALIB_FIX_K2 {"K2", true};
     ofParameter<bool> pCV_CALIB_FIX_K3 {"K3", true};
     ofParameter<bool> pCV_CALIB_ZERO_TANGENT_DIST {"Zero", true};
+    ofParameter<bool> pLockIntrinsics {"Lock", false}; // only solve the pose
     ofParameterGroup  pg {"Flags",
         pCV_CALIB_FIX_PRINCIPAL_POINT,
         pCV_CALIB_FIX_ASPECT_RATIO,
         pCV_CALIB_FIX_K1,
         pCV_CALIB_FIX_K2,
         pCV_CALIB_FIX_K3,
-        pCV_CALIB_ZERO_TANGENT_DIST
+        pCV_CALIB_ZERO_TANGENT_DIST,
+        pLockIntrinsics
     };
     
-    void update(int width, int height, vector<ofVec2f>& imagePoints, vector<ofVec3f>& objectPoints) {
-        int n = imagePoints.size();
-        const static int minPoints = 6;
-        if(n < minPoints) {
-            calibrationReady = false;
-            return;
-        }
-        vector<cv::Mat> rvecs, tvecs;
-        cv::Mat distCoeffs;
-        objectPointsCv[0].clear();
-        imagePointsCv[0].clear();
-        for(int i = 0; i < n; i++) {
-            objectPointsCv[0].push_back(ofxCv::toCv(objectPoints[i]));
-            imagePointsCv[0].push_back(ofxCv::toCv(imagePoints[i]));
+    // everything a solve produces, plain values so it can be made on another thread
+    struct Solution {
+        PoseSolver::Result pose;
+        vector<cv::Point3f> objectPoints;
+        vector<cv::Point2f> imagePoints;
+    };
+    
+    // the calibration as it is now, for the next solve to start from
+    PoseSolver::Result getPose() const {
+        PoseSolver::Result pose;
+        pose.ready = calibrationReady && !rvec.empty() && !tvec.empty();
+        if(pose.ready){
+            pose.cameraMatrix = intrinsics.getCameraMatrix().clone();
+            pose.rvec = rvec.clone();
+            pose.tvec = tvec.clone();
+            pose.imageSize = intrinsics.getImageSize();
         }
-        float aov = 80; // decent guess
-        imageSize.width = width;
-        imageSize.height = height;
-        float f = imageSize.width * ofDegToRad(aov); // this might be wrong, but it's optimized out
-        cv::Point2f c = cv::Point2f(imageSize) * (1. / 2);
-        cv::Mat1d cameraMatrix = (cv::Mat1d(3, 3) <<
-                                  f, 0, c.x,
-                                  0, f, c.y,
-                                  0, 0, 1);
+        return pose;
+    }
+    
+    int getFlags() const {
         int flags = CV_CALIB_USE_INTRINSIC_GUESS;
-
+        
         if (pCV_CALIB_FIX_PRINCIPAL_POINT) flags |= CV_CALIB_FIX_PRINCIPAL_POINT;
         if (pCV_CALIB_FIX_ASPECT_RATIO) flags |= CV_CALIB_FIX_ASPECT_RATIO;
         if (pCV_CALIB_FIX_K1) flags |= CV_CALIB_FIX_K1;
         if (pCV_CALIB_FIX_K2) flags |= CV_CALIB_FIX_K2;
         if (pCV_CALIB_FIX_K3) flags |= CV_CALIB_FIX_K3;
         if (pCV_CALIB_ZERO_TANGENT_DIST) flags |= CV_CALIB_ZERO_TANGENT_DIST;
-
-        calibrateCamera(objectPointsCv, imagePointsCv, imageSize, cameraMatrix, distCoeffs, rvecs, tvecs, flags);
-        rvec = rvecs[0];
-        tvec = tvecs[0];
-        intrinsics.setup(cameraMatrix, imageSize);
+        return flags;
+    }
+    
+    // touches nothing but its arguments, safe to call from any thread
+    static Solution solve(int width, int height, const vector<ofVec2f>& imagePoints, const vector<ofVec3f>& objectPoints, int flags, const PoseSolver::Result * previous = nullptr, bool lockIntrinsics = false) {
+        Solution solution;
+        for(size_t i = 0; i < imagePoints.size() && i < objectPoints.size(); i++) {
+            solution.objectPoints.push_back(ofxCv::toCv(objectPoints[i]));
+            solution.imagePoints.push_back(ofxCv::toCv(imagePoints[i]));
+        }
+        solution.pose = PoseSolver::solve(solution.objectPoints, solution.imagePoints, cv::Size(width, height), flags, previous, lockIntrinsics);
+        return solution;
+    }
+    
+    // takes over a solution, on the thread that draws with the camera
+    void apply(const Solution & solution) {
+        if(!solution.pose.ready) {
+            calibrationReady = false;
+            return;
+        }
+        rvec = solution.pose.rvec;
+        tvec = solution.pose.tvec;
+        imageSize = solution.pose.imageSize;
+        solveTier = solution.pose.tier;
+        reprojectionError = solution.pose.error;
+        objectPointsCv[0] = solution.objectPoints;
+        imagePointsCv[0] = solution.imagePoints;
+        intrinsics.setup(solution.pose.cameraMatrix, imageSize);
         modelMatrix = ofxCv::makeMatrix(rvec, tvec);
         cam.setupPerspective();
         cam.setNearClip(nearClip);
@@ -80,6 +106,11 @@ public:
         cam.setOrientation(modelMatrix.getRotate());
         calibrationReady = true;
     }
+    
+    void update(int width, int height, vector<ofVec2f>& imagePoints, vector<ofVec3f>& objectPoints) {
+        const auto previous = getPose();
+        apply(solve(width, height, imagePoints, objectPoints, getFlags(), &previous, pLockIntrinsics));
+    }
     void begin(ofRectangle viewPort) {
         if(calibrationReady) {
             ofPushMatrix();
@@ -161,33 +192,12 @@ public:
         fs["objectPoints"] >> objPointsMat;
         fs["imagePoints"] >> imgPointsMat;
 
-        int numVals;
-        float x, y, z;
-        cv::Point3f oP;
-        
-        const float* objVals = objPointsMat.ptr<float>(0);
-        numVals = objPointsMat.cols * objPointsMat.rows;
-        
+        // one point per element, as written by save
         objectPointsCv[0].clear();
-
-        for(int i = 0; i < numVals; i+=3) {
-            oP.x = objVals[i];
-            oP.y = objVals[i+1];
-            oP.z = objVals[i+2];
-            objectPointsCv[0].push_back(oP);
-        }
-        
-        cv::Point2f iP;
-        
-        const float* imgVals = imgPointsMat.ptr<float>(0);
-        numVals = objPointsMat.cols * objPointsMat.rows;
-        
         imagePointsCv[0].clear();
-
-        for(int i = 0; i < numVals; i+=2) {
-            iP.x = imgVals[i];
-            iP.y = imgVals[i+1];
-            imagePointsCv[0].push_back(iP);
+        if(objPointsMat.type() == CV_32FC3 && imgPointsMat.type() == CV_32FC2 && objPointsMat.total() == imgPointsMat.total()) {
+            objPointsMat.reshape(3, 1).copyTo(objectPointsCv[0]);
+            imgPointsMat.reshape(2, 1).copyTo(imagePointsCv[0]);
         }
         
         cv::Mat cameraMatrix;
@@ -205,4 +215,46 @@ public:
         }
 
     }
+    
+    // the binary store, see CalibrationRecord
+    void toRecord(CalibrationRecord & record) const {
+        record.objectPoints.clear();
+        record.imagePoints.clear();
+        for(size_t i = 0; i < objectPointsCv[0].size() && i < imagePointsCv[0].size(); i++) {
+            const cv::Point3f & o = objectPointsCv[0][i];
+            const cv::Point2f & p = imagePointsCv[0][i];
+            record.objectPoints.push_back({o.x, o.y, o.z});
+            record.imagePoints.push_back({p.x, p.y});
+        }
+        record.calibrated = calibrationReady && rvec.total() == 3 && tvec.total() == 3;
+        if(!record.calibrated) return;
+        const cv::Mat1d cameraMatrix = intrinsics.getCameraMatrix();
+        const cv::Mat1d r = rvec.reshape(1, 3), t = tvec.reshape(1, 3);
+        for(int i = 0; i < 9; i++) record.cameraMatrix[i] = cameraMatrix(i / 3, i % 3);
+        for(int i = 0; i < 3; i++) {
+            record.rvec[i] = r(i);
+            record.tvec[i] = t(i);
+        }
+        record.imageWidth = intrinsics.getImageSize().width;
+        record.imageHeight = intrinsics.getImageSize().height;
+    }
+    
+    void fromRecord(const CalibrationRecord & record){
+        objectPointsCv[0].clear();
+        imagePointsCv[0].clear();
+        for(size_t i = 0; i < record.objectPoints.size(); i++) {
+            const auto & o = record.objectPoints[i];
+            const auto & p = record.imagePoints[i];
+            objectPointsCv[0].push_back(cv::Point3f(o.x, o.y, o.z));
+            imagePointsCv[0].push_back(cv::Point2f(p.x, p.y));
+        }
+        calibrationReady = record.calibrated;
+        if(!calibrationReady) return;
+        const cv::Mat cameraMatrix = cv::Mat(3, 3, CV_64F, (void*)record.cameraMatrix).clone();
+        rvec = cv::Mat(3, 1, CV_64F, (void*)record.rvec).clone();
+        tvec = cv::Mat(3, 1, CV_64F, (void*)record.tvec).clone();
+        imageSize = cv::Size2i(record.imageWidth, record.imageHeight);
+        intrinsics.setup(cameraMatrix, imageSize);
+        modelMatrix = ofxCv::makeMatrix(rvec, tvec);
+    }
 };
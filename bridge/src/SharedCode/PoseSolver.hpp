@@ -0,0 +1,225 @@
+#pragma once
+
+//
+//  PoseSolver.hpp
+//  bridge
+//
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Projector calibration from 2d-3d point pairs, only OpenCV so the
+// benchmark in bridge/bench can run it without openFrameworks.
+//
+// Three tiers, the cheapest that applies is used:
+//  - intrinsics locked: only the pose is solved again, with solvePnP starting
+//    from the previous pose
+//  - a previous calibration of the same image size: calibrateCamera starts from
+//    its camera matrix instead of a guess
+//  - nothing to start from: a closed form DLT gives the camera matrix
+//    calibrateCamera starts from, the old 80 degree guess when the points are
+//    degenerate for it
+// Distortion is solved for but left out of the result, the projection matrix
+// the app renders with has none. So after calibrateCamera the pose is solved
+// again without distortion, with solvePnP starting from the previous or the
+// DLT pose.
+
+class PoseSolver {
+public:
+
+    enum Tier {
+        NONE,
+        LOCKED,
+        WARM,
+        COLD,
+        GUESS
+    };
+
+    struct Result {
+        bool ready = false;
+        Tier tier = NONE;
+        cv::Mat cameraMatrix; // 3x3 double
+        cv::Mat rvec, tvec; // 3x1 double
+        cv::Size imageSize;
+        double error = 0; // rms reprojection error in pixels
+    };
+
+    static const int minPoints = 6; // for calibrateCamera, solvePnP gets along with 4
+
+    static const char * getTierName(Tier tier){
+        static const char * names[] = {"none", "locked", "warm", "cold", "guess"};
+        return names[tier];
+    }
+
+    // previous may be null, or a result for other points
+    static Result solve(const std::vector<cv::Point3f> & objectPoints, const std::vector<cv::Point2f> & imagePoints, cv::Size imageSize, int flags, const Result * previous = nullptr, bool lockIntrinsics = false){
+        Result result;
+        result.imageSize = imageSize;
+        const int n = std::min(objectPoints.size(), imagePoints.size());
+        const bool canWarmStart = previous != nullptr && previous->ready && previous->imageSize == imageSize;
+
+        if(lockIntrinsics && canWarmStart && n >= 4){
+            result.cameraMatrix = previous->cameraMatrix.clone();
+            result.rvec = previous->rvec.clone();
+            result.tvec = previous->tvec.clone();
+            cv::solvePnP(objectPoints, imagePoints, result.cameraMatrix, cv::noArray(), result.rvec, result.tvec, true, cv::SOLVEPNP_ITERATIVE);
+            result.tier = LOCKED;
+        } else {
+            if(n < minPoints) return result;
+            cv::Mat1d cameraMatrix;
+            cv::Mat rvec, tvec; // where the pose solve starts
+            if(canWarmStart){
+                cameraMatrix = previous->cameraMatrix.clone();
+                constrain(cameraMatrix, imageSize, flags); // the flags may have changed since
+                rvec = previous->rvec.clone();
+                tvec = previous->tvec.clone();
+                result.tier = WARM;
+            } else if(dlt(objectPoints, imagePoints, cameraMatrix, rvec, tvec)){
+                constrain(cameraMatrix, imageSize, flags);
+                result.tier = COLD;
+            } else {
+                cameraMatrix = guess(imageSize);
+                result.tier = GUESS;
+            }
+            calibrate(objectPoints, imagePoints, imageSize, flags, cameraMatrix, result.rvec, result.tvec);
+            result.cameraMatrix = cameraMatrix;
+            if(!rvec.empty()){
+                result.rvec = rvec;
+                result.tvec = tvec;
+            }
+            cv::solvePnP(objectPoints, imagePoints, result.cameraMatrix, cv::noArray(), result.rvec, result.tvec, true, cv::SOLVEPNP_ITERATIVE);
+        }
+        result.error = reprojectionError(objectPoints, imagePoints, result);
+        result.ready = true;
+        return result;
+    }
+
+    static double reprojectionError(const std::vector<cv::Point3f> & objectPoints, const std::vector<cv::Point2f> & imagePoints, const Result & result){
+        if(objectPoints.empty()) return 0;
+        std::vector<cv::Point2f> projected;
+        cv::projectPoints(objectPoints, result.rvec, result.tvec, result.cameraMatrix, cv::noArray(), projected);
+        double sum = 0;
+        for(size_t i = 0; i < projected.size(); i++){
+            const cv::Point2f d = projected[i] - imagePoints[i];
+            sum += d.dot(d);
+        }
+        return std::sqrt(sum / projected.size());
+    }
+
+    // calibrateCamera starting from the given camera matrix
+    static void calibrate(const std::vector<cv::Point3f> & objectPoints, const std::vector<cv::Point2f> & imagePoints, cv::Size imageSize, int flags, cv::Mat1d & cameraMatrix, cv::Mat & rvec, cv::Mat & tvec){
+        std::vector<std::vector<cv::Point3f> > objectPointsCv(1, objectPoints);
+        std::vector<std::vector<cv::Point2f> > imagePointsCv(1, imagePoints);
+        std::vector<cv::Mat> rvecs, tvecs;
+        cv::Mat distCoeffs;
+        cv::calibrateCamera(objectPointsCv, imagePointsCv, imageSize, cameraMatrix, distCoeffs, rvecs, tvecs, flags | cv::CALIB_USE_INTRINSIC_GUESS);
+        rvec = rvecs[0];
+        tvec = tvecs[0];
+    }
+
+    // the guess calibrateCamera always started from
+    static cv::Mat1d guess(cv::Size imageSize){
+        const double aov = 80; // decent guess
+        const double f = imageSize.width * aov * CV_PI / 180.0; // this might be wrong, but it's optimized out
+        return (cv::Mat1d(3, 3) <<
+                f, 0, imageSize.width / 2.0,
+                0, f, imageSize.height / 2.0,
+                0, 0, 1);
+    }
+
+    // camera matrix and pose from a 3x4 projection matrix fitted to at least six
+    // points that do not all lie in one plane, false when they do
+    static bool dlt(const std::vector<cv::Point3f> & objectPoints, const std::vector<cv::Point2f> & imagePoints, cv::Mat1d & cameraMatrix, cv::Mat & rvec, cv::Mat & tvec){
+        const int n = std::min(objectPoints.size(), imagePoints.size());
+        if(n < minPoints) return false;
+
+        // centered and scaled, or the system is badly conditioned in pixels and meters
+        cv::Point3d objectCenter(0, 0, 0);
+        cv::Point2d imageCenter(0, 0);
+        for(int i = 0; i < n; i++){
+            objectCenter += cv::Point3d(objectPoints[i]);
+            imageCenter += cv::Point2d(imagePoints[i]);
+        }
+        objectCenter *= 1.0 / n;
+        imageCenter *= 1.0 / n;
+        double objectSpread = 0, imageSpread = 0;
+        for(int i = 0; i < n; i++){
+            objectSpread += cv::norm(cv::Point3d(objectPoints[i]) - objectCenter);
+            imageSpread += cv::norm(cv::Point2d(imagePoints[i]) - imageCenter);
+        }
+        if(objectSpread == 0 || imageSpread == 0) return false;
+        const double objectScale = std::sqrt(3.0) * n / objectSpread;
+        const double imageScale = std::sqrt(2.0) * n / imageSpread;
+
+        cv::Mat1d A = cv::Mat1d::zeros(2 * n, 12);
+        for(int i = 0; i < n; i++){
+            const cv::Point3d X = (cv::Point3d(objectPoints[i]) - objectCenter) * objectScale;
+            const cv::Point2d x = (cv::Point2d(imagePoints[i]) - imageCenter) * imageScale;
+            const double h[4] = {X.x, X.y, X.z, 1.0};
+            double * r0 = A[2 * i];
+            double * r1 = A[2 * i + 1];
+            for(int j = 0; j < 4; j++){
+                r0[j] = h[j];
+                r0[8 + j] = -x.x * h[j];
+                r1[4 + j] = h[j];
+                r1[8 + j] = -x.y * h[j];
+            }
+        }
+        // the projection is the null vector, a second one means the points lie in a plane
+        cv::SVD svd(A, cv::SVD::FULL_UV);
+        const cv::Mat1d w = svd.w;
+        if(w(10) < 1e-4 * w(0)) return false;
+        const cv::Mat1d p = svd.vt.row(11).t();
+
+        // back to pixels and meters
+        const cv::Mat1d imageDenormalize = (cv::Mat1d(3, 3) <<
+                                            1.0 / imageScale, 0, imageCenter.x,
+                                            0, 1.0 / imageScale, imageCenter.y,
+                                            0, 0, 1);
+        const cv::Mat1d objectNormalize = (cv::Mat1d(4, 4) <<
+                                           objectScale, 0, 0, -objectScale * objectCenter.x,
+                                           0, objectScale, 0, -objectScale * objectCenter.y,
+                                           0, 0, objectScale, -objectScale * objectCenter.z,
+                                           0, 0, 0, 1);
+        cv::Mat1d P = imageDenormalize * p.reshape(1, 3) * objectNormalize;
+
+        // the points are in front of the camera
+        const cv::Mat1d first = (cv::Mat1d(4, 1) << objectPoints[0].x, objectPoints[0].y, objectPoints[0].z, 1.0);
+        if(cv::Mat1d(P.row(2) * first)(0) < 0) P = -P;
+
+        cv::Mat1d K, R;
+        cv::RQDecomp3x3(P.colRange(0, 3), K, R);
+        // positive focal lengths, the sign goes into the rotation
+        for(int i = 0; i < 3; i++){
+            if(K(i, i) < 0){
+                K.col(i) *= -1;
+                R.row(i) *= -1;
+            }
+        }
+        if(cv::determinant(R) < 0) return false; // mirrored, the points are degenerate
+        const cv::Mat1d t = K.inv() * P.col(3);
+        cameraMatrix = K / K(2, 2);
+        cameraMatrix(0, 1) = 0;
+        cv::Rodrigues(R, rvec);
+        tvec = cv::Mat(t).clone();
+        return std::isfinite(cameraMatrix(0, 0)) && cameraMatrix(0, 0) > 0 && cameraMatrix(1, 1) > 0;
+    }
+
+private:
+
+    // what the flags keep fixed has to be right in the start value already
+    static void constrain(cv::Mat1d & cameraMatrix, cv::Size imageSize, int flags){
+        if(flags & cv::CALIB_FIX_ASPECT_RATIO){
+            const double f = (cameraMatrix(0, 0) + cameraMatrix(1, 1)) / 2.0;
+            cameraMatrix(0, 0) = f;
+            cameraMatrix(1, 1) = f;
+        }
+        if(flags & cv::CALIB_FIX_PRINCIPAL_POINT){
+            cameraMatrix(0, 2) = imageSize.width / 2.0;
+            cameraMatrix(1, 2) = imageSize.height / 2.0;
+        }
+    }
+};
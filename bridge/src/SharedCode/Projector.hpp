@@ -11,12 +11,15 @@
 #include "ofMain.h"
 #include "Mapamok.hpp"
 #include "DraggablePoints.hpp"
+#include "CalibrationSolver.hpp"
+#include "CalibrationRecord.hpp"
 
 class Projector{
     
 public:
     ofRectangle viewPort;
     Mapamok mapamok;
+    CalibrationSolver solver;
     DraggablePoints referencePoints;
     ofMesh cornerMeshImage;
     
@@ -27,6 +30,13 @@ public:
     bool renderingHdr = false;
     bool forcingEasyCam = false;
     bool inited = false;
+    ofMatrix4x4 cornerProjection; // the easy cam, for calibrate
+    Mapamok::Solution waitedSolution;
+    bool hasWaitedSolution = false;
+    double residual = 0; // rms pixels of the hit points against the calibration in use
+    int solvedFlags = 0;
+    bool solvedLocked = false;
+    glm::vec2 solvedSize;
     
     ofFbo::Settings & defaultFboSettings;
     
@@ -111,10 +121,25 @@ public:
         
         cam.setControlArea(viewPort);
     }
-    void update(ofMesh & cornerMesh){
-        
-        cornerMeshImage = cornerMesh;
-        
+    // The calibration runs in three steps, so ofApp can run the middle one for all
+    // projectors at once on its worker pool. prepare and finish touch the cameras
+    // and the events and belong on the GL thread, calibrate only touches this
+    // projector and the corner mesh.
+    void update(const ofMesh & cornerMesh){
+        prepare(cornerMesh);
+        calibrate(cornerMesh);
+        finish();
+    }
+    
+    void prepare(const ofMesh & cornerMesh){
+        // clearing touches the easy cam's mouse events, the points are put on
+        // their corners in calibrate
+        if(cornerMesh.getNumVertices() != referencePoints.size()) {
+            referencePoints.clear();
+            for(int i = 0; i < cornerMesh.getNumVertices(); i++) {
+                referencePoints.add(ofVec2f());
+            }
+        }
         if(pCalibrationEdit){
             referencePoints.enableControlEvents();
             //referencePoints.enableDrawEvent();
@@ -122,45 +147,87 @@ public:
             referencePoints.disableControlEvents();
             //referencePoints.disableDrawEvent();
         }
+        cornerProjection = cam.getModelViewProjectionMatrix(viewPort - viewPort.getPosition());
+    }
+    
+    // projects the corners, follows the points and solves when they changed. The
+    // first solve, at startup or after loading, runs right here so it is done before
+    // the next frame, later ones go to the solver thread so dragging a point never
+    // waits for calibrateCamera
+    void calibrate(const ofMesh & cornerMesh){
+        
+        cornerMeshImage = cornerMesh;
         
         if(pCalibrationEdit || !inited){
 
-        project(cornerMeshImage, cam, viewPort - viewPort.getPosition());
-        
-        if(cornerMesh.getNumVertices() != referencePoints.size()) {
-            referencePoints.clear();
-            for(int i = 0; i < cornerMeshImage.getNumVertices(); i++) {
-                referencePoints.add(ofVec2f(cornerMeshImage.getVertex(i)));
-            }
-        }
-        
+        project(cornerMeshImage, cornerProjection, viewPort - viewPort.getPosition());
         
-        // otherwise, update the points
+        // update the points
+        vector<ofVec2f> imagePoints;
+        vector<ofVec3f> objectPoints;
         for(int i = 0; i < referencePoints.size(); i++) {
             DraggablePoint& cur = referencePoints.get(i);
             if(!cur.hit) {
                 cur.position = cornerMeshImage.getVertex(i);
+            } else {
+                imagePoints.push_back(cur.position);
+                objectPoints.push_back(cornerMesh.getVertex(i));
             }
         }
         
-        // calculating the 3d mesh
-        vector<ofVec2f> imagePoints;
-        vector<ofVec3f> objectPoints;
-        for(int j = 0; j < referencePoints.size(); j++) {
-            DraggablePoint& cur =  referencePoints.get(j);
-            if(cur.hit) {
-                imagePoints.push_back(cur.position);
-                objectPoints.push_back(cornerMesh.getVertex(j));
+        // how far the points are from the calibration in use, while a solve is pending
+        const auto pose = mapamok.getPose();
+        residual = 0;
+        if(pose.ready){
+            vector<cv::Point3f> objectPointsCv;
+            vector<cv::Point2f> imagePointsCv;
+            for(size_t i = 0; i < imagePoints.size(); i++){
+                objectPointsCv.push_back(ofxCv::toCv(objectPoints[i]));
+                imagePointsCv.push_back(ofxCv::toCv(imagePoints[i]));
             }
+            residual = PoseSolver::reprojectionError(objectPointsCv, imagePointsCv, pose);
+        }
+        
+        // only solve again when the points, the flags or the size changed
+        const int flags = mapamok.getFlags();
+        const bool lockIntrinsics = mapamok.pLockIntrinsics;
+        if(referencePoints.dirty || !inited || flags != solvedFlags || lockIntrinsics != solvedLocked || viewPort.getWidth() != solvedSize.x || viewPort.getHeight() != solvedSize.y){
+            if(inited){
+                CalibrationSolver::Request request;
+                request.width = viewPort.width;
+                request.height = viewPort.height;
+                request.flags = flags;
+                request.previous = pose;
+                request.lockIntrinsics = lockIntrinsics;
+                request.imagePoints = std::move(imagePoints);
+                request.objectPoints = std::move(objectPoints);
+                solver.request(std::move(request));
+            } else {
+                solver.wait(); // or an older solve lands after this one
+                waitedSolution = Mapamok::solve(viewPort.width, viewPort.height, imagePoints, objectPoints, flags, &pose, lockIntrinsics);
+                hasWaitedSolution = true;
+                residual = waitedSolution.pose.error;
+            }
+            referencePoints.dirty = false;
+            solvedFlags = flags;
+            solvedLocked = lockIntrinsics;
+            solvedSize = glm::vec2(viewPort.getWidth(), viewPort.getHeight());
         }
-        // should only calculate this when the points are updated
-        mapamok.update(viewPort.width, viewPort.height, imagePoints, objectPoints);
             inited = true;
         }
     }
     
-    void project(ofMesh& mesh, const ofCamera& camera, ofRectangle viewport) {
-        ofMatrix4x4 modelViewProjectionMatrix = camera.getModelViewProjectionMatrix(viewport);
+    void finish(){
+        if(solver.update()){
+            mapamok.apply(solver.getSolution());
+        }
+        if(hasWaitedSolution){
+            mapamok.apply(waitedSolution);
+            hasWaitedSolution = false;
+        }
+    }
+    
+    void project(ofMesh& mesh, const ofMatrix4x4& modelViewProjectionMatrix, ofRectangle viewport) {
         viewport.width /= 2;
         viewport.height /= 2;
         for(int i = 0; i < mesh.getNumVertices(); i++) {
@@ -174,16 +241,40 @@ public:
         }
     }
     
+    // calibration.bin when it is there and intact, otherwise the yml and json, which
+    // every save writes as well for people to read and edit. Delete calibration.bin
+    // to load edited ones.
     void load(string filePath) {
-        mapamok.load(filePath);
-        referencePoints.load(filePath);
+        CalibrationRecord record;
+        if(record.load(ofToDataPath(filePath + "/calibration.bin", true))) {
+            mapamok.fromRecord(record);
+            referencePoints.fromRecord(record);
+        } else {
+            mapamok.load(filePath);
+            referencePoints.load(filePath);
+            if(referencePoints.size() > 0 && saveRecord(filePath)) {
+                ofLogNotice("Projector") << "imported " << filePath << " into calibration.bin";
+            }
+        }
+        inited = false; // solved again before the next frame
     }
     
     void save(string filePath) {
+        ofDirectory::createDirectory(filePath, true, true);
+        if(!saveRecord(filePath)) {
+            ofLogError("Projector") << "could not write " << filePath << "/calibration.bin";
+        }
         mapamok.save(filePath);
         referencePoints.save(filePath);
     }
     
+    bool saveRecord(string filePath) {
+        CalibrationRecord record;
+        mapamok.toRecord(record);
+        referencePoints.toRecord(record);
+        return record.save(ofToDataPath(filePath + "/calibration.bin", true));
+    }
+    
     void renderCalibrationEditor(ofxAssimp3dPrimitive * calibrationPrimitive){
         if(pCalibrationEdit){
             begin(false, false);
@@ -333,7 +424,8 @@ public:
                     ofTranslate(0, -viewPort.height/2.0);
                 }
                 
-                for(int i = 0; i < referencePoints.size(); i++) {
+                // no corners yet while they are baked
+                for(int i = 0; i < referencePoints.size() && i < cornerMeshImage.getNumVertices(); i++) {
                     DraggablePoint& cur = referencePoints.get(i);
                     ofSetColor(0, 64);
                     ofFill();
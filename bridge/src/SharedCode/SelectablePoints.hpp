@@ -2,6 +2,7 @@
 
 #include "EventWatcher.hpp"
 #include "DraggablePoint.hpp"
+#include "CalibrationRecord.hpp"
 
 class SelectablePoints : public EventWatcher {
 protected:
@@ -34,6 +35,7 @@ public:
     void clear() {
         points.clear();
         selected.clear();
+        dirty = true;
         if(cam != nullptr) cam->enableMouseInput();
     }
 	void setClickRadius(float clickRadius) {
@@ -61,6 +63,8 @@ public:
 				selected.erase(i);
 			}
 		}
+        // a point that was hit now counts for the calibration
+        if(hitAny) dirty = true;
         if(cam != nullptr){
             if(selected.size() == 0){
                 cam->enableMouseInput();
@@ -138,4 +142,19 @@ public:
             points.back().hit = p["hit"];
         }
     }
+    
+    // the binary store, see CalibrationRecord
+    void toRecord(CalibrationRecord & record) const {
+        record.referencePoints.clear();
+        for(auto & p : points){
+            record.referencePoints.push_back({p.position.x, p.position.y, p.hit});
+        }
+    }
+    void fromRecord(const CalibrationRecord & record){
+        clear();
+        for(auto & p : record.referencePoints){
+            add(ofVec2f(p.x, p.y));
+            points.back().hit = p.hit != 0;
+        }
+    }
 };
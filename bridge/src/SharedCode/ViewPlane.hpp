@@ -31,6 +31,9 @@ public:
     
     ofVec3f windowTopLeft, windowBottomLeft, windowBottomRight;
     
+    uint64_t poseMicros = 0; // ofGetElapsedTimeMicros() when the camera pose was set
+    uint64_t beginMicros = 0; // and at the first begin() with that pose
+    
     ViewPlane(ofFbo::Settings & defaultFboSettings, ofShader & highlightShader, ofShader & tonemapShader, ofShader & fxaaShader, ofxAssimp3dPrimitive * viewNode, World & world)
     : defaultFboSettings(defaultFboSettings), highlightShader(highlightShader), tonemapShader(tonemapShader), fxaaShader(fxaaShader), viewNode(viewNode), world(world)
     {
@@ -128,6 +131,8 @@ public:
         
         renderingHdr = hdr;
         
+        if(beginMicros < poseMicros) beginMicros = ofGetElapsedTimeMicros();
+        
         // TODO: Orient ViewPortal
         
         float width = plane.getWidth();
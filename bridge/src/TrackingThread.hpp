@@ -0,0 +1,677 @@
+//
+//  TrackingThread.hpp
+//  bridge
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "MeshTracker.hpp"
+#include "TripleBuffer.hpp"
+#include "DepthSensor.hpp"
+#include "HeadPipeline.hpp"
+#include "HeadPoseRing.hpp"
+#include "LatencyStats.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Values from pgTracking the tracking thread needs, written by the render thread.
+struct TrackingSettings {
+    glm::vec3 cameraPosition;
+    glm::vec3 cameraRotation;
+    glm::vec3 boxPosition;
+    glm::vec3 boxRotation;
+    glm::vec3 boxSize = {1., 1., 1.};
+    glm::vec3 startPosition;
+    bool pointsVisible = false;
+    int maxHeads = 3;
+    bool backgroundSubtraction = true;
+    bool backgroundLearning = false; // the room is expected to be empty
+    bool detection = true;
+    float minHeadHeight = 1.0;
+    bool oneEuroSmoothing = false; // instead of the Kalman filters
+    OneEuroFilter::Settings oneEuro;
+    float syncWindow = 0.010; // s, frames of several sensors this close are fused
+};
+
+// Copy of a head's state as seen by the render thread.
+struct TrackedHead {
+    int id = 0;
+    int trackId = 0;
+    HeadTrack::TRACKING_STATE state = HeadTrack::TRACKING_STATE::READY;
+    glm::vec3 globalPosition;
+    glm::vec3 rawGlobalPosition;
+    glm::vec3 globalFloorPoint;
+    float radius = 0.0;
+    float firstTimeTracking = 0;
+    float lastTimeTracking = 0;
+    float lastTrackPointWeighedCount = 1.0;
+
+    bool isReady() const {
+        return state == HeadTrack::TRACKING_STATE::READY;
+    }
+
+    bool isTracking() const {
+        return state == HeadTrack::TRACKING_STATE::TRACKING;
+    }
+
+    bool isLost() const {
+        return state == HeadTrack::TRACKING_STATE::LOST;
+    }
+
+    bool isTrackingOrLost() const {
+        return isTracking() || isLost();
+    }
+};
+
+// Result of one depth frame, published by the tracking thread.
+struct TrackingFrame {
+    static const uint8_t coarseLabel = 4;
+
+    unsigned long long frameNumber = 0; // fused frames so far
+    double deviceTimestamp = 0.0; // ms, on the clock of the first sensor
+    float hostTime = 0.0; // ofGetElapsedTimef() when the frame arrived
+    uint64_t arrivalMicros = 0; // ofGetElapsedTimeMicros() when the oldest fused frame arrived
+    int sensorsFused = 0;
+    uint64_t publishMicros = 0; // and when the heads were handed to the render thread
+
+    glm::mat4 boxTransform;
+    glm::vec3 boxSize;
+    glm::vec3 startingPoint;
+
+    vector<TrackedHead> heads;
+    vector<glm::vec3> candidates; // detected head positions
+
+    unsigned long long backgroundFrames = 0; // frames the background model has learned from
+
+    // debug point cloud in the first tracking camera's space, only filled when pointsVisible
+    vector<glm::vec3> points;
+    vector<uint8_t> labels; // as from HeadTracker::addVertices, coarseLabel for the coarse points
+};
+
+// Fuses the depth sensors into one MeshTracker and runs it on a thread of its
+// own, so the render loop never waits for the cameras.
+//
+// Every sensor filters on its own thread. This thread wakes up with the first
+// new frame, gives the other sensors until the sync window closes to deliver
+// theirs, and runs HeadPipeline::Fusion on all of them, which gathers their
+// points into the space of the first camera, the one the tracker works in.
+// A sensor that misses the window is fused on the next round.
+//
+// In remote mode the heads come from a headtrack-service process through a
+// HeadPoseRing instead, and the sensors here stay idle. The tracker process
+// can then be restarted while the app keeps the last heads.
+
+class TrackingThread {
+public:
+
+    ~TrackingThread(){
+        stop();
+    }
+
+    // the first sensor's pose comes from the settings, the others keep the one they are given
+    void setup(const vector<DepthSensor::Config> & configs, bool realtime, int maxHeads, glm::vec3 startPosition){
+
+        sensors.clear();
+        views = vector<SensorView>(configs.size());
+        for(size_t s = 0; s < configs.size(); s++){
+            auto source = makeDepthSource(configs[s].source);
+            source->setRealtime(realtime);
+            sensors.emplace_back(new DepthSensor());
+            sensors[s]->setup(source, HeadPipeline::coarseLevel, [this]{
+                {
+                    std::lock_guard<std::mutex> lock(wakeMutex);
+                    wakeCount++;
+                }
+                wakeCondition.notify_one();
+            });
+
+            auto & view = views[s];
+            view.camera.setParent(origin);
+            view.camera.setPosition(configs[s].position);
+            view.camera.setOrientation(configs[s].rotation);
+            view.pipeline.setup();
+        }
+
+        tracker.setup(maxHeads, startPosition, primaryCamera(), origin);
+
+        TrackingFrame initialFrame;
+        writeFrame(initialFrame);
+        frameBuffer.fill(initialFrame);
+        remoteFrame = initialFrame;
+        remoteIncoming = initialFrame;
+
+        headProxy.set(1.0, 1);
+    }
+
+    void start(){
+        if(running || !isOpen()) return;
+        for(auto & sensor : sensors){
+            sensor->start();
+        }
+        running = true;
+        thread = std::thread(&TrackingThread::threadedFunction, this);
+    }
+
+    void stop(){
+        running = false;
+        wakeCondition.notify_one();
+        if(thread.joinable()){
+            thread.join();
+        }
+        for(auto & sensor : sensors){
+            sensor->stop();
+        }
+    }
+
+    // RENDER THREAD
+
+    void setEnabled(bool e){
+        enabled = e;
+        for(auto & sensor : sensors){
+            sensor->setEnabled(e);
+        }
+    }
+
+    // record unfiltered depth frames to a raw depth file, one per sensor with its index appended
+    void startRecording(string path){
+        for(size_t s = 0; s < sensors.size(); s++){
+            if(sensors.size() > 1){
+                sensors[s]->setRecording(ofFilePath::removeExt(path) + "-" + ofToString(s) + "." + ofFilePath::getFileExt(path));
+            } else {
+                sensors[s]->setRecording(path);
+            }
+        }
+    }
+
+    void stopRecording(){
+        for(auto & sensor : sensors){
+            sensor->setRecording("");
+        }
+    }
+
+    bool isRecording() const {
+        for(auto & sensor : sensors){
+            if(sensor->isRecording()) return true;
+        }
+        return false;
+    }
+
+    // forget the learned background, it is learned again while the room is empty
+    void resetBackground(){
+        backgroundResetRequested = true;
+    }
+
+    bool isOpen() const {
+        for(auto & sensor : sensors){
+            if(sensor->isOpen()) return true;
+        }
+        return false;
+    }
+
+    size_t getNumSensors() const {
+        return sensors.size();
+    }
+
+    const DepthSource * getSource(size_t sensor = 0) const {
+        return sensors[sensor]->getSource();
+    }
+
+    // the tracking stages are recorded here, the render thread adds its own
+    LatencyStats & getLatency(){
+        return latency;
+    }
+
+    void setSettings(const TrackingSettings & settings){
+        settingsBuffer.getWriteBuffer() = settings;
+        settingsBuffer.publish();
+
+        remoteSettings = toPipelineSettings(settings);
+        remoteBox = HeadPipeline::poseMatrix(settings.boxPosition, settings.boxRotation);
+        remoteBoxSize = settings.boxSize;
+        remoteStartingPoint = settings.startPosition;
+        if(remote && ring.isOpen() && memcmp(&remoteSettings, &writtenSettings, sizeof(remoteSettings)) != 0){
+            ring.writeSettings(remoteSettings);
+            writtenSettings = remoteSettings;
+        }
+    }
+
+    // take the heads from a tracker process publishing to the shared memory name
+    void setRemote(bool r, const string & name = "/oresund-heads"){
+        if(r == remote && name == ringName) return;
+        remote = r;
+        ringName = name;
+        ring.close();
+        remoteWritten = 0;
+        lastRingAttempt = -1;
+    }
+
+    bool isRemote() const {
+        return remote;
+    }
+
+    // a tracker process published within the last second
+    bool isRemoteRunning() const {
+        return remote && ring.isOpen() && ofGetElapsedTimef() - lastRemoteFrameTime < 1.0;
+    }
+
+    int getRemotePid() const {
+        return ring.isOpen() ? ring.getWriterPid() : 0;
+    }
+
+    // fetch the latest published frame, returns true if it is new
+    bool update(){
+        if(remote) return updateRemote();
+        return frameBuffer.update();
+    }
+
+    const TrackingFrame & getFrame() const {
+        return remote ? remoteFrame : frameBuffer.getReadBuffer();
+    }
+
+    void draw(){
+        auto & frame = getFrame();
+
+        ofPushStyle();
+        ofNoFill();
+        ofSetColor(255,255,255,255);
+        ofPushMatrix();
+        ofMultMatrix(frame.boxTransform);
+        ofDrawBox(frame.boxSize.x, frame.boxSize.y, frame.boxSize.z);
+        ofPopMatrix();
+        ofFill();
+        ofSetColor(255,0,255,255);
+        ofDrawSphere(frame.startingPoint, 0.05);
+        ofSetColor(255,128,0,255);
+        for(auto & candidate : frame.candidates){
+            ofDrawSphere(candidate, 0.025);
+        }
+        for(auto & head : frame.heads){
+            if(head.isTracking()){
+                ofSetColor(0,255,0,255);
+            } else if (head.isReady()){
+                ofSetColor(0,255,255,255);
+            } else if (head.isLost()){
+                ofSetColor(255,255,0,255);
+            }
+            headProxy.setScale(head.radius);
+            headProxy.setGlobalPosition(head.globalPosition);
+            headProxy.drawWireframe();
+            ofSetColor(255,0,0,255);
+            ofDrawLine(head.globalPosition, head.globalFloorPoint);
+            ofSetColor(255,255);
+            ofDrawBitmapString(ofToString(head.lastTrackPointWeighedCount), head.globalPosition);
+            ofDrawCone(head.globalFloorPoint, 0.025, 0.05);
+        }
+        ofPopStyle();
+    }
+
+private:
+
+    struct SensorView {
+        ofNode camera;
+        HeadPipeline::View pipeline; // cameraToOutput goes into the first camera's space
+        bool fresh = false; // has a frame that is not fused yet
+    };
+
+    static HeadPipeline::ViewFrame toViewFrame(const SensorFrame & sensorFrame){
+        HeadPipeline::ViewFrame frame;
+        frame.depth = &sensorFrame.depth;
+        frame.intrinsics = sensorFrame.intrinsics;
+        frame.pyramid = &sensorFrame.pyramid;
+        frame.depthScale = sensorFrame.depthScale;
+        return frame;
+    }
+
+    static HeadPipeline::Settings toPipelineSettings(const TrackingSettings & settings){
+        HeadPipeline::Settings s;
+        memset((void*)&s, 0, sizeof(s)); // compared as bytes
+        s.cameraPosition = settings.cameraPosition;
+        s.cameraRotation = settings.cameraRotation;
+        s.boxPosition = settings.boxPosition;
+        s.boxRotation = settings.boxRotation;
+        s.boxSize = settings.boxSize;
+        s.startPosition = settings.startPosition;
+        s.maxHeads = std::max(1, std::min<int>(settings.maxHeads, HeadKernel::maxHeads));
+        s.backgroundSubtraction = settings.backgroundSubtraction;
+        s.backgroundLearning = settings.backgroundLearning;
+        s.detection = settings.detection;
+        s.minHeadHeight = settings.minHeadHeight;
+        s.oneEuroSmoothing = settings.oneEuroSmoothing;
+        s.oneEuro = settings.oneEuro;
+        return s;
+    }
+
+    // reads the newest frame of the tracker process, if there is one
+    bool updateRemote(){
+        if(!ring.isOpen()){
+            if(ofGetElapsedTimef() - lastRingAttempt < 1.0) return false;
+            lastRingAttempt = ofGetElapsedTimef();
+            if(!ring.open(ringName)) return false;
+            ofLogNotice("TrackingThread") << "reading heads from " << ringName;
+            ring.writeSettings(remoteSettings);
+            writtenSettings = remoteSettings;
+        }
+        const uint64_t written = ring.getWritten();
+        if(written == remoteWritten) return false;
+
+        // tracker clock to app clock, both count the same seconds
+        const double now = headPoseClock();
+        const float nowTime = ofGetElapsedTimef();
+        const uint64_t nowMicros = ofGetElapsedTimeMicros();
+        auto toAppMicros = [&](double t){ return nowMicros - uint64_t(std::max(0.0, now - t) * 1e6); };
+
+        // converted right in the segment, only the heads the frame has are read, into
+        // a frame of its own as a torn read is thrown away
+        auto & incoming = remoteIncoming;
+        const bool read = ring.readLatest([&](const HeadPoseFrame & pose){
+            const float arrivalTime = nowTime - (now - pose.arrivalTime); // the tracker was updated with this
+            auto toAppTime = [&](float t){ return t == 0 ? 0.f : arrivalTime + (t - pose.trackerTime); };
+            incoming.frameNumber = pose.frameNumber;
+            incoming.deviceTimestamp = pose.deviceTimestamp;
+            incoming.hostTime = arrivalTime;
+            incoming.arrivalMicros = toAppMicros(pose.arrivalTime);
+            incoming.publishMicros = toAppMicros(pose.publishTime);
+            // may be torn until readLatest checked the sequence
+            const int headCount = std::max(0, std::min<int>(pose.headCount, HeadKernel::maxHeads));
+            incoming.heads.resize(std::max(headCount, 1));
+            if(headCount == 0){
+                // nobody there, a ready head at the starting point like a fresh tracker has
+                auto & t = incoming.heads[0];
+                t = TrackedHead();
+                t.globalPosition = remoteStartingPoint;
+                t.rawGlobalPosition = remoteStartingPoint;
+                t.globalFloorPoint = glm::vec3(remoteStartingPoint.x, 0, remoteStartingPoint.z);
+                t.radius = tracker.headRadius;
+            }
+            for(int i = 0; i < headCount; i++){
+                auto & h = pose.heads[i];
+                auto & t = incoming.heads[i];
+                t.id = h.id;
+                t.trackId = h.trackId;
+                t.state = h.state;
+                t.globalPosition = h.globalPosition;
+                t.rawGlobalPosition = h.rawGlobalPosition;
+                t.globalFloorPoint = h.globalFloorPoint;
+                t.radius = h.radius;
+                t.firstTimeTracking = toAppTime(h.firstTimeTracking);
+                t.lastTimeTracking = toAppTime(h.lastTimeTracking);
+                t.lastTrackPointWeighedCount = h.lastTrackPointWeighedCount;
+            }
+        });
+        if(!read) return false;
+        remoteWritten = written;
+        std::swap(remoteFrame, remoteIncoming);
+
+        auto & frame = remoteFrame;
+        frame.sensorsFused = 1;
+        frame.boxTransform = remoteBox;
+        frame.boxSize = remoteBoxSize;
+        frame.startingPoint = remoteStartingPoint;
+        frame.candidates.clear();
+        frame.points.clear();
+        frame.labels.clear();
+        lastRemoteFrameTime = nowTime;
+        return true;
+    }
+
+    ofNode & primaryCamera(){
+        return views[0].camera;
+    }
+
+    // picks up new frames, returns true if any sensor has one waiting, call with wakeMutex held
+    bool pollSensors(){
+        seenWakeCount = wakeCount;
+        bool any = false;
+        for(size_t s = 0; s < sensors.size(); s++){
+            if(sensors[s]->update()) views[s].fresh = true;
+            any |= views[s].fresh;
+        }
+        return any;
+    }
+
+    bool allFresh() const {
+        for(size_t s = 0; s < sensors.size(); s++){
+            if(sensors[s]->isOpen() && !views[s].fresh) return false;
+        }
+        return true;
+    }
+
+    // waits for a first new frame and then up to syncWindow for the other sensors
+    bool collectFrames(float syncWindow){
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        auto woken = [this]{ return wakeCount != seenWakeCount || !running; };
+        if(!pollSensors()){
+            wakeCondition.wait_for(lock, std::chrono::milliseconds(1000), woken);
+            if(!pollSensors()) return false;
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(int64_t(syncWindow * 1e6));
+        while(running && !allFresh()){
+            if(!wakeCondition.wait_until(lock, deadline, woken)) break;
+            pollSensors();
+        }
+        return true;
+    }
+
+    void threadedFunction(){
+        while(running){
+            if(!enabled){
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+
+            if(!collectFrames(settingsBuffer.getReadBuffer().syncWindow)){
+                continue;
+            }
+            auto fuseMicros = ofGetElapsedTimeMicros();
+
+            if(settingsBuffer.update()){
+                applySettings(settingsBuffer.getReadBuffer());
+            }
+            const auto & settings = settingsBuffer.getReadBuffer();
+            bool pointsVisible = settings.pointsVisible;
+
+            // frames captured too long before the newest one are left out. Capture times
+            // compare across sensors only when all of them stamp global time, otherwise
+            // the arrival times have to do, USB jitter and all
+            bool globalTime = true;
+            uint64_t newestArrival = 0;
+            for(size_t s = 0; s < views.size(); s++){
+                if(!views[s].fresh) continue;
+                newestArrival = std::max(newestArrival, sensors[s]->getFrame().arrivalMicros);
+                globalTime &= sensors[s]->getFrame().globalTime;
+            }
+            auto syncTime = [&](const SensorFrame & f){ return globalTime ? f.deviceTimestamp : f.arrivalMicros / 1000.0; };
+            double newestSync = -std::numeric_limits<double>::max();
+            for(size_t s = 0; s < views.size(); s++){
+                if(views[s].fresh) newestSync = std::max(newestSync, syncTime(sensors[s]->getFrame()));
+            }
+            uint64_t oldestArrival = newestArrival;
+            int fused = 0;
+            for(size_t s = 0; s < views.size(); s++){
+                if(!views[s].fresh) continue;
+                auto & sensorFrame = sensors[s]->getFrame();
+                if(newestSync - syncTime(sensorFrame) > settings.syncWindow * 1000.0){
+                    views[s].fresh = false;
+                    continue;
+                }
+                oldestArrival = std::min(oldestArrival, sensorFrame.arrivalMicros);
+                fused++;
+                if(sensorFrame.captureLatency >= 0){
+                    latency.record(LatencyStats::CAPTURE, sensorFrame.captureLatency);
+                }
+                latency.record(LatencyStats::FILTER, (sensorFrame.filteredMicros - sensorFrame.arrivalMicros) / 1000.0);
+            }
+
+            // the tracker works in the first camera's space
+            tracker.syncNodes();
+            const glm::mat4 trackerInverse = glm::inverse(tracker.getGlobalTransformMatrix());
+            const glm::mat4 primaryGlobal = primaryCamera().getGlobalTransformMatrix();
+            const glm::mat4 primaryInverse = glm::inverse(primaryGlobal);
+            const glm::vec3 halfSize(tracker.getWidth()/2.0, tracker.getHeight()/2.0, tracker.getDepth()/2.0);
+
+            if(backgroundResetRequested){
+                for(auto & view : views){
+                    view.pipeline.resetBackground();
+                }
+                backgroundResetRequested = false;
+            }
+
+            auto & frame = frameBuffer.getWriteBuffer();
+            frame.points.clear();
+            frame.labels.clear();
+
+            fusion.begin(tracker, toPipelineSettings(settings), pointsVisible);
+            for(size_t s = 0; s < views.size(); s++){
+                auto & view = views[s];
+                if(!view.fresh) continue;
+                const glm::mat4 cameraGlobal = view.camera.getGlobalTransformMatrix();
+                view.pipeline.cameraToOutput = primaryInverse * cameraGlobal;
+                fusion.prepare(view.pipeline, toViewFrame(sensors[s]->getFrame()), trackerInverse * cameraGlobal, halfSize);
+            }
+            fusion.detect(tracker, trackerInverse * primaryGlobal, primaryGlobal, halfSize);
+            frame.candidates = fusion.getCandidates();
+            for(size_t s = 0; s < views.size(); s++){
+                if(views[s].fresh) fusion.gather(tracker, views[s].pipeline, toViewFrame(sensors[s]->getFrame()));
+            }
+            fusion.classify(tracker);
+
+            if(pointsVisible){
+                // the coarse points show the rest of the box, the shader colours the labels
+                auto & coarsePoints = fusion.getCoarsePoints();
+                auto & points = fusion.getPoints();
+                auto & labels = fusion.getLabels();
+                frame.points.resize(coarsePoints.count + points.count);
+                frame.labels.resize(coarsePoints.count + points.count);
+                for(size_t i=0; i<coarsePoints.count; i++){
+                    frame.points[i] = glm::vec3(coarsePoints.x[i], coarsePoints.y[i], coarsePoints.z[i]);
+                    frame.labels[i] = TrackingFrame::coarseLabel;
+                }
+                for(size_t i=0; i<points.count; i++){
+                    frame.points[coarsePoints.count + i] = glm::vec3(points.x[i], points.y[i], points.z[i]);
+                }
+                std::copy(labels.begin(), labels.end(), frame.labels.begin() + coarsePoints.count);
+            }
+            tracker.update();
+            latency.record(LatencyStats::TRACK, (ofGetElapsedTimeMicros() - fuseMicros) / 1000.0);
+
+            // the first sensor's clock, carried on from its last frame when it is not in this one
+            auto & reference = sensors[0]->getFrame();
+            if(views[0].fresh){
+                frame.deviceTimestamp = reference.deviceTimestamp;
+                frame.hostTime = reference.hostTime;
+            } else {
+                const double sinceReference = (int64_t(newestArrival) - int64_t(reference.arrivalMicros)) / 1000.0;
+                frame.deviceTimestamp = reference.deviceTimestamp + sinceReference;
+                frame.hostTime = reference.hostTime + sinceReference / 1000.0;
+            }
+            frame.frameNumber = ++fusedFrames;
+            frame.arrivalMicros = oldestArrival;
+            frame.sensorsFused = fused;
+            frame.backgroundFrames = views[0].pipeline.background.getLearnedFrames();
+            writeFrame(frame);
+            frame.publishMicros = ofGetElapsedTimeMicros();
+            frameBuffer.publish();
+
+            for(auto & view : views){
+                view.fresh = false;
+            }
+        }
+    }
+
+    void applySettings(const TrackingSettings & settings){
+        auto & camera = primaryCamera();
+        camera.setPosition(settings.cameraPosition);
+        camera.setOrientation(settings.cameraRotation);
+        tracker.setPosition(settings.boxPosition);
+        tracker.setOrientation(settings.boxRotation);
+        if(settings.boxSize != boxSize){
+            // regenerating the box mesh is expensive, only do it when it changes
+            tracker.set(settings.boxSize.x, settings.boxSize.y, settings.boxSize.z);
+            boxSize = settings.boxSize;
+        }
+        tracker.startingPoint.setGlobalPosition(settings.startPosition);
+        if(settings.maxHeads != int(tracker.size())){
+            tracker.setMaxHeads(settings.maxHeads);
+        }
+        tracker.setSmoothing(settings.oneEuroSmoothing, settings.oneEuro);
+        tracker.camera.setGlobalPosition(camera.getGlobalPosition());
+        tracker.camera.setGlobalOrientation(camera.getGlobalOrientation());
+        tracker.camera.setScale(camera.getScale());
+    }
+
+    // copy tracker state into a frame for the render thread
+    void writeFrame(TrackingFrame & frame){
+        frame.boxTransform = tracker.getGlobalTransformMatrix();
+        frame.boxSize = glm::vec3(tracker.getWidth(), tracker.getHeight(), tracker.getDepth());
+        frame.startingPoint = tracker.startingPoint.getGlobalPosition();
+        frame.heads.resize(tracker.size());
+        for(size_t i = 0; i < tracker.size(); i++){
+            auto & h = tracker.getHead(i);
+            auto & t = frame.heads[i];
+            t.id = h.id;
+            t.trackId = h.trackId;
+            t.state = h.state;
+            t.globalPosition = tracker.getGlobalPosition(h);
+            t.rawGlobalPosition = h.rawGlobalPosition;
+            t.globalFloorPoint = tracker.getGlobalFloorPoint(h);
+            t.radius = h.radius;
+            t.firstTimeTracking = h.firstTimeTracking;
+            t.lastTimeTracking = h.lastTimeTracking;
+            t.lastTrackPointWeighedCount = h.lastTrackPointWeighedCount;
+        }
+    }
+
+    // DEPTH PIPELINE, only touched by the tracking thread after setup
+
+    vector<std::unique_ptr<DepthSensor>> sensors;
+    vector<SensorView> views; // one per sensor, never resized after setup
+    unsigned long long fusedFrames = 0;
+
+    HeadPipeline::Fusion fusion;
+    LatencyStats latency;
+    std::atomic<bool> backgroundResetRequested {false};
+
+    // private node tree, world.origin is never transformed
+    ofNode origin;
+    glm::vec3 boxSize;
+
+    MeshTracker tracker;
+
+    // THREADING
+
+    TripleBuffer<TrackingSettings> settingsBuffer;
+    TripleBuffer<TrackingFrame> frameBuffer;
+
+    std::thread thread;
+    std::atomic<bool> running {false};
+    std::atomic<bool> enabled {false};
+
+    // sensors wake the tracking thread through this
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    unsigned long long wakeCount = 0;
+    unsigned long long seenWakeCount = 0;
+
+    // render thread only
+    ofIcoSpherePrimitive headProxy;
+
+    // REMOTE, render thread only
+
+    bool remote = false;
+    string ringName;
+    HeadPoseRing ring;
+    uint64_t remoteWritten = 0;
+    float lastRingAttempt = -1;
+    float lastRemoteFrameTime = -1;
+    TrackingFrame remoteFrame;
+    TrackingFrame remoteIncoming;
+    HeadPipeline::Settings remoteSettings, writtenSettings;
+    glm::mat4 remoteBox;
+    glm::vec3 remoteBoxSize;
+    glm::vec3 remoteStartingPoint;
+};
@@ -0,0 +1,63 @@
+//
+//  TripleBuffer.hpp
+//  bridge
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer triple buffer.
+// The producer always has a buffer to write into and the consumer always
+// reads the most recently published one, so neither side ever waits.
+
+template<typename T>
+class TripleBuffer {
+public:
+
+    // set all three slots, only call before producer and consumer are running
+    void fill(const T & value){
+        for(auto & buffer : buffers){
+            buffer = value;
+        }
+    }
+
+    // PRODUCER
+
+    T & getWriteBuffer(){
+        return buffers[backIndex];
+    }
+
+    void publish(){
+        uint8_t old = state.exchange(backIndex | freshBit, std::memory_order_acq_rel);
+        backIndex = old & indexMask;
+    }
+
+    // CONSUMER
+
+    // returns true if a new buffer was published since the last call
+    bool update(){
+        if((state.load(std::memory_order_acquire) & freshBit) == 0){
+            return false;
+        }
+        uint8_t old = state.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = old & indexMask;
+        return true;
+    }
+
+    const T & getReadBuffer() const {
+        return buffers[frontIndex];
+    }
+
+private:
+    static constexpr uint8_t indexMask = 0x3;
+    static constexpr uint8_t freshBit = 0x4;
+
+    T buffers[3];
+
+    // index of the middle buffer and whether it holds unread data
+    std::atomic<uint8_t> state {1};
+    uint8_t backIndex = 0;
+    uint8_t frontIndex = 2;
+};
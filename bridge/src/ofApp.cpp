@@ -64,6 +64,7 @@ void ofApp::setup() {
     shader.bindDefaults();
     videoShader.loadAuto("shaders/videoshader");
     videoShader.bindDefaults();
+    pointShader.loadAuto("shaders/pointLabels");
     
     // PROJECTORS
     
@@ -101,6 +102,7 @@ void ofApp::setup() {
         pgProjectors.add(projector.second->pg);
         projector.second->load("calibrations/" + projector.first);
     }
+    calibrationPool.setup(std::max<int>(0, int(mProjectors.size()) - 1)); // the GL thread takes the last one
     pgProjectors.setName("Projectors");
     pgGlobal.add(pgProjectors);
     
@@ -292,80 +294,14 @@ void ofApp::setup() {
     
     // TRACKING
     
-    trackingKalman.init(1/100000000., 1/50000.); // inverse of (smoothness, rapidness);
+    trackingKalman.setup(1, 1/100000000., 1/50000.); // inverse of (smoothness, rapidness);
 
-    trackingMesh.setMode(OF_PRIMITIVE_POINTS);
-    rs2::config cfg;
-    cfg.enable_stream(RS2_STREAM_DEPTH, 848, 480, RS2_FORMAT_ANY, 60);
-    selection = pipe.start(cfg);
-    
-    // Find first depth sensor (devices can have zero or more then one)
-    auto depth_sensor = selection.get_device().first<rs2::depth_sensor>();
-    if (depth_sensor.supports(RS2_OPTION_EMITTER_ENABLED))
-    {
-        depth_sensor.set_option(RS2_OPTION_EMITTER_ENABLED, 1.f); // Enable emitter
-    }
-    if (depth_sensor.supports(RS2_OPTION_ENABLE_AUTO_EXPOSURE))
-    {
-        depth_sensor.set_option(RS2_OPTION_ENABLE_AUTO_EXPOSURE, 1.f);
-    }
-    
-    /*    if (depth_sensor.supports(RS2_OPTION_GAIN))
-     {
-     depth_sensor.set_option(RS2_OPTION_GAIN, 32.f);
-     }
-     if (depth_sensor.supports(RS2_OPTION_EXPOSURE))
-     {
-     depth_sensor.set_option(RS2_OPTION_EXPOSURE, 4000.f);
-     }
-     */
-    if (depth_sensor.supports(RS2_OPTION_LASER_POWER))
-    {
-        // Query min and max values:
-        auto range = depth_sensor.get_option_range(RS2_OPTION_LASER_POWER);
-        depth_sensor.set_option(RS2_OPTION_LASER_POWER, range.max); // Set max power
-    }
-    
-    auto scale =  depth_sensor.get_depth_scale();
-    
-    auto stream = pipe.get_active_profile().get_stream(RS2_STREAM_DEPTH);
-    if (auto video_stream = stream.as<rs2::video_stream_profile>())
-    {
-        try
-        {
-            //If the stream is indeed a video stream, we can now simply call get_intrinsics()
-            intrinsics = video_stream.get_intrinsics();
-            
-            auto principal_point = std::make_pair(intrinsics.ppx, intrinsics.ppy);
-            auto focal_length = std::make_pair(intrinsics.fx, intrinsics.fy);
-            rs2_distortion model = intrinsics.model;
-            /*
-            std::cout << "Principal Point         : " << principal_point.first << ", " << principal_point.second << std::endl;
-            std::cout << "Focal Length            : " << focal_length.first << ", " << focal_length.second << std::endl;
-            std::cout << "Distortion Model        : " << model << std::endl;
-            std::cout << "Distortion Coefficients : [" << intrinsics.coeffs[0] << "," << intrinsics.coeffs[1] << "," <<
-            intrinsics.coeffs[2] << "," << intrinsics.coeffs[3] << "," << intrinsics.coeffs[4] << "]" << std::endl;
-             */
-        }
-        catch (const std::exception& e)
-        {
-            std::cerr << "Failed to get intrinsics for the given stream. " << e.what() << std::endl;
-        }
-    }
-    
-    dec_filter.set_option(RS2_OPTION_FILTER_MAGNITUDE, 2.0);
-    spat_filter.set_option(RS2_OPTION_FILTER_SMOOTH_ALPHA, 0.95f);
-    temp_filter.set_option(RS2_OPTION_FILTER_SMOOTH_ALPHA, 0.1f);
-    temp_filter.set_option(RS2_OPTION_FILTER_SMOOTH_DELTA, 65.0f);
-    temp_filter.set_option(RS2_OPTION_HOLES_FILL, 7);
-    
     trackingCamera.setParent(world.origin);
     trackingCamera.setupPerspective();
     trackingCamera.setAspectRatio(848.0/480.0);
     trackingCamera.setFov(86.0);
     trackingCamera.setNearClip(0.1);
     trackingCamera.setFarClip(50.0);
-    tracker.setup(3, glm::vec3(1.95,1.0,-.85), trackingCamera, world.origin );
     
     triggerBox.setParent(world.origin);
     
@@ -373,6 +309,17 @@ void ofApp::setup() {
     
     load("default");
     
+    // TRACKING SOURCE
+    
+    // the camera in pgTracking, and any further ones from settings/sensors.json
+    vector<DepthSensor::Config> sensorConfigs(1);
+    sensorConfigs[0].source = pTrackingSource;
+    for(auto & config : loadSensorConfigs("settings/sensors.json")){
+        sensorConfigs.push_back(config);
+    }
+    tracking.setup(sensorConfigs, pTrackingRealtime, pTrackingMaxHeads, glm::vec3(1.95,1.0,-.85));
+    tracking.start();
+    
     // TIMELINE
     
     timelineFloatOutputs["envExposure"]().makeReferenceTo(pPbrEnvExposure);
@@ -428,6 +375,19 @@ void ofApp::update() {
     // TIMELINE
     timeline.step(ofGetLastFrameTime());
     
+    // CALIBRATION CORNERS
+    if(cornerMeshBake.valid() && cornerMeshBake.wait_for(std::chrono::seconds(0)) == std::future_status::ready){
+        calibrationCornerMesh = cornerMeshBake.get();
+        calibrationCornerMesh.setMode(OF_PRIMITIVE_POINTS);
+        ofLogNotice("update") << ofGetTimestampString(timestampFormat)<<"\t" << "baked " << calibrationCornerMesh.getNumVertices() << " calibration corners";
+        if(calibrationCornerMesh.getNumVertices() == 0){
+            ofLogError("update") << ofGetTimestampString(timestampFormat)<<"\t" << "the calibration model has no vertices, projectors will not be calibrated";
+        }
+        if(!CornerMeshCache::save(cornerMeshCachePath, cornerMeshKey, calibrationCornerMesh)){
+            ofLogError("update") << "could not write " << cornerMeshCachePath;
+        }
+    }
+    
     // PBR UPDATES
     cubeMap.setEnvLevel(pPbrEnvLevel);
     cubeMap.setExposure(pPbrEnvExposure);
@@ -450,87 +410,77 @@ void ofApp::update() {
     //TRACKER
     trackingCamera.setPosition(pTrackingCameraPosition);
     trackingCamera.setOrientation(pTrackingCameraRotation);
-    tracker.setPosition(pTrackingBoxPosition);
-    tracker.setOrientation(pTrackingBoxRotation);
-    tracker.set(pTrackingBoxSize.get().x, pTrackingBoxSize.get().y, pTrackingBoxSize.get().z);
-    tracker.startingPoint.setGlobalPosition(pTrackingStartPosition);
-    tracker.camera.setGlobalPosition(trackingCamera.getGlobalPosition());
-    tracker.camera.setGlobalOrientation(trackingCamera.getGlobalOrientation());
-    tracker.camera.setScale(trackingCamera.getScale());
     
     triggerBox.setPosition(pTriggerBoxPosition);
     triggerBox.setOrientation(pTriggerBoxRotation);
     triggerBox.set(pTriggerBoxSize.get().x, pTriggerBoxSize.get().y, pTriggerBoxSize.get().z);
     
-    const auto cameraGlobalMat = trackingCamera.getGlobalTransformMatrix();
-    const auto trackerInverse = glm::inverse(tracker.getGlobalTransformMatrix());
     const auto triggerBoxInverse = glm::inverse(triggerBox.getGlobalTransformMatrix());
     
-    if(pTrackingEnabled){
-        // Get depth data from camera
-        auto frames = pipe.wait_for_frames();
-        auto depth = frames.get_depth_frame();
+    TrackingSettings trackingSettings;
+    trackingSettings.cameraPosition = pTrackingCameraPosition;
+    trackingSettings.cameraRotation = pTrackingCameraRotation;
+    trackingSettings.boxPosition = pTrackingBoxPosition;
+    trackingSettings.boxRotation = pTrackingBoxRotation;
+    trackingSettings.boxSize = pTrackingBoxSize;
+    trackingSettings.startPosition = pTrackingStartPosition;
+    trackingSettings.pointsVisible = pTrackingVisible;
+    trackingSettings.maxHeads = pTrackingMaxHeads;
+    trackingSettings.backgroundSubtraction = pTrackingBackground;
+    trackingSettings.backgroundLearning = appState == state::WAITING;
+    trackingSettings.detection = pTrackingDetection;
+    trackingSettings.minHeadHeight = pTrackingMinHeadHeight;
+    trackingSettings.oneEuroSmoothing = pTrackingOneEuro;
+    trackingSettings.oneEuro.minCutoff = pTrackingOneEuroMinCutoff;
+    trackingSettings.oneEuro.beta = pTrackingOneEuroBeta;
+    trackingSettings.syncWindow = pTrackingSyncWindow;
+    tracking.setRemote(pTrackingRemote);
+    tracking.setSettings(trackingSettings);
+    tracking.setEnabled(pTrackingEnabled && !pTrackingRemote);
+    
+    // the tracking thread publishes a new frame whenever the camera delivers one
+    if(tracking.update() && pTrackingEnabled){
+        auto & trackingFrame = tracking.getFrame();
+        auto & latency = tracking.getLatency();
+        auto fetchMicros = ofGetElapsedTimeMicros();
+        latency.record(LatencyStats::HANDOFF, (fetchMicros - trackingFrame.publishMicros) / 1000.0);
         
-        rs2::frame filtered = depth;
-        // Note the concatenation of output/input frame to build up a chain
-        filtered = dec_filter.process(filtered);
-        filtered = spat_filter.process(filtered);
-        filtered = temp_filter.process(filtered);
+        if(pTrackingVisible){
+            trackingPoints.upload(trackingFrame.points, trackingFrame.labels);
+        }
         
-        points = pc.calculate(filtered);
+        auto & frontHead = trackingFrame.heads.front();
+        trackingKalman.update(&frontHead.globalPosition); // feed measurement
+        // the one euro filter in the tracker is enough, a second stage only adds lag
+        glm::vec3 smoothedHead = pTrackingOneEuro ? frontHead.globalPosition : trackingKalman.getEstimation(0);
+        pHeadPosition.set(smoothedHead+pHeadOffset.get());
+        headArrivalMicros = trackingFrame.arrivalMicros;
+        headPoseMicros = ofGetElapsedTimeMicros();
+        latency.record(LatencyStats::SMOOTH, (headPoseMicros - fetchMicros) / 1000.0);
         
-        // Create oF mesh
-        trackingMesh.clear();
-        int n = points.size();
-        if(n!=0){
-            const rs2::vertex * vs = points.get_vertices();
-            for(int i=0; i<n; i++){
-                if(vs[i].z>0.5){ // save time on skipping the closest ones
-                    const rs2::vertex v = vs[i];
-                    glm::vec3 v3(v.x,-v.y,-v.z);
-                    glm::vec4 cameraVec(v3, 1.0);
-                    glm::vec4 globalVec = cameraGlobalMat * cameraVec;
-                    
-                    auto inversedVec = trackerInverse * globalVec;
-                    glm::vec3 trackerVec = glm::vec3(inversedVec) / inversedVec.w;
-                    
-                    if(fabs(trackerVec.x) < tracker.getWidth()/2.0 &&
-                       fabs(trackerVec.y) < tracker.getHeight()/2.0 &&
-                       fabs(trackerVec.z) < tracker.getDepth()/2.0){
-                        
-                        int wasAdded = tracker.addVertex(v3);
-                        
-                        if(pTrackingVisible){
-                            
-                            trackingMesh.addVertex(v3);
-                            
-                            ofFloatColor c;
-                            if(wasAdded == 0){
-                                c = ofFloatColor::lightGray;
-                            } else if (wasAdded == 1){
-                                c = ofFloatColor::cyan;
-                            } else if (wasAdded == 2){
-                                c= ofFloatColor::green;
-                            } else if (wasAdded == 3){
-                                c = ofFloatColor::blueSteel;
-                            }
-                            
-                            trackingMesh.addColor(c);
-                        }
-                        
-                    }
-                }
-            }
-            tracker.update();
+        // a different person in front, or nobody tracking, the old motion says nothing about them
+        const int frontTrackId = frontHead.isTracking() ? frontHead.trackId : 0;
+        if(frontTrackId != headPredictorTrackId){
+            headPredictor.reset();
+            trackingLag.reset();
+            headPredictorTrackId = frontTrackId;
+        }
+        if(frontHead.isTracking()){
+            headPredictor.addSample(smoothedHead, trackingFrame.deviceTimestamp, trackingFrame.hostTime);
+            trackingLag.update(frontHead.rawGlobalPosition, smoothedHead, trackingFrame.hostTime);
         }
-        trackingKalman.update(tracker.heads.front().getGlobalPosition()); // feed measurement
-        pHeadPosition.set(trackingKalman.getEstimation()+pHeadOffset.get());
+    }
+    
+    // extrapolate the head to when this frame is expected on screen
+    if(pTrackingEnabled && pTrackingPrediction && headPredictor.isValid()){
+        pHeadPosition.set(headPredictor.predict(ofGetElapsedTimef() + pTrackingPredictionHorizon)+pHeadOffset.get());
+        headPoseMicros = ofGetElapsedTimeMicros();
     }
     
     // STATE manipulation
     
     auto formerState = appState;
-    auto & oldestTracker = tracker.heads.front();
+    auto & oldestTracker = tracking.getFrame().heads.front();
     
     if(oldestTracker.isTrackingOrLost()) {
         if(formerState == state::WAITING){
@@ -677,6 +627,10 @@ void ofApp::update() {
     
 }
 
+void ofApp::exit() {
+    tracking.stop();
+}
+
 void ofApp::pbrRenderScene() {
     
     ofEnableDepthTest();
@@ -807,10 +761,23 @@ void ofApp::draw() {
     ofEnableAlphaBlending();
     
     //PROJECTORS NEED TO BE UPDATED IN DRAW
+    // every enabled projector calibrates as a job of its own on the pool, they are
+    // all done before anything is drawn
+    // not while the corners are being baked, the reference points would be cleared
+    calibratingProjectors.clear();
     for (auto projector : mProjectors){
-        if(projector.second->pEnabled){
-            projector.second->update(calibrationCornerMesh);
+        if(projector.second->pEnabled && calibrationCornerMesh.getNumVertices() > 0){
+            projector.second->prepare(calibrationCornerMesh);
+            calibratingProjectors.push_back(projector.second.get());
         }
+    }
+    calibrationPool.parallelFor(calibratingProjectors.size(), [this](size_t i){
+        calibratingProjectors[i]->calibrate(calibrationCornerMesh);
+    });
+    for (auto projector : calibratingProjectors){
+        projector->finish();
+    }
+    for (auto projector : mProjectors){
         if(projector.first == "first person"){
             projector.second->referencePoints.disableDrawEvent();
             projector.second->referencePoints.disableControlEvents();
@@ -828,6 +795,8 @@ void ofApp::draw() {
     }
     mViewFront->cam.setGlobalPosition(pHeadPosition);
     mViewSide->cam.setGlobalPosition(pHeadPosition);
+    mViewFront->poseMicros = headPoseMicros;
+    mViewSide->poseMicros = headPoseMicros;
     
     
     // LGIHTS TOO
@@ -1020,11 +989,13 @@ void ofApp::draw() {
                     trackingCamera.transformGL();
                     ofDrawAxis(0.1);
                     if(pTrackingVisible){
-                        trackingMesh.draw();
+                        pointShader.begin();
+                        trackingPoints.draw(pointShader);
+                        pointShader.end();
                     }
                     trackingCamera.restoreTransformGL();
                     trackingCamera.drawFrustum();
-                    tracker.draw();
+                    tracking.draw();
                     ofSetColor(0,255,0, 64);
                     triggerBox.draw();
                     
@@ -1049,6 +1020,15 @@ void ofApp::draw() {
         ofPopStyle();
     }
     
+    // how old the head position is by the time the projectors show it
+    if(pTrackingEnabled && headArrivalMicros > 0 && mViewFront->beginMicros >= mViewFront->poseMicros){
+        auto & latency = tracking.getLatency();
+        auto drawnMicros = ofGetElapsedTimeMicros();
+        latency.record(LatencyStats::VIEW, (mViewFront->beginMicros - mViewFront->poseMicros) / 1000.0);
+        latency.record(LatencyStats::PROJECTOR, (drawnMicros - mViewFront->beginMicros) / 1000.0);
+        latency.record(LatencyStats::TOTAL, (drawnMicros - headArrivalMicros) / 1000.0);
+    }
+    
     // GUI
     ofEnableBlendMode(OF_BLENDMODE_ALPHA);
     ofFill();
@@ -1152,18 +1132,30 @@ void ofApp::loadNodeModel(string filename) {
     // get calibration pritive out of the drawing tree
     world.primitives["room.calibration"]->clearParent();
     
-    // bake calibration meshe
-    ofLogNotice("loadNodeModel") << ofGetTimestampString(timestampFormat)<<"\t" << "baking calibration mesh";
-    calibrationMesh = ofVboMesh();
-    calibrationMesh = joinMeshes(calibrationMeshes);
-    ofVec3f cornerMin, cornerMax;
-    getBoundingBox(calibrationMesh, cornerMin, cornerMax);
-    
+    // the calibration corners come from the disk cache, or are baked in the
+    // background when the model or the settings changed
+    cornerMeshCachePath = filename + ".corners";
+    cornerMeshKey = CornerMeshCache::key(filename, {mergeTolerance, cornerRatio, float(cornerMinimum), selectionMergeTolerance});
+    ofMesh cachedCorners;
+    calibrationCornerMesh = ofVboMesh();
+    if(CornerMeshCache::load(cornerMeshCachePath, cornerMeshKey, cachedCorners) && cachedCorners.getNumVertices() > 0){
+        ofLogNotice("loadNodeModel") << ofGetTimestampString(timestampFormat)<<"\t" << "loaded " << cachedCorners.getNumVertices() << " calibration corners from cache";
+        calibrationCornerMesh = cachedCorners;
+        calibrationCornerMesh.setMode(OF_PRIMITIVE_POINTS);
+    } else {
+        ofLogNotice("loadNodeModel") << ofGetTimestampString(timestampFormat)<<"\t" << "baking calibration corners";
+        cornerMeshBake = std::async(std::launch::async, [this, calibrationMeshes]{
+            return bakeCornerMesh(calibrationMeshes);
+        });
+    }
+}
+
+ofMesh ofApp::bakeCornerMesh(const vector<ofMesh> & calibrationMeshes) const {
     // merge
     // another good metric for finding corners is if there is a single vertex touching
     // the wall of the bounding box, that point is a good control point
     
-    calibrationCornerMesh = ofVboMesh();
+    ofMesh cornerMesh;
     for(int i = 0; i < calibrationMeshes.size(); i++) {
         ofMesh mergedMesh = mergeNearbyVertices(calibrationMeshes[i], mergeTolerance);
         if(mergedMesh.getVertices().size() > cornerMinimum){
@@ -1173,12 +1165,17 @@ void ofApp::loadNodeModel(string filename) {
             for(int j = 0; j < n; j++) {
                 int index = cornerIndices[j];
                 const ofVec3f& corner = mergedMesh.getVertices()[index];
-                calibrationCornerMesh.addVertex(corner);
+                cornerMesh.addVertex(corner);
             }
         }
     }
-    calibrationCornerMesh = mergeNearbyVertices(calibrationCornerMesh, selectionMergeTolerance);
-    calibrationCornerMesh.setMode(OF_PRIMITIVE_POINTS);
+    // no mesh with enough vertices for corners, calibrate against the whole model instead
+    if(cornerMesh.getNumVertices() == 0){
+        for(int i = 0; i < calibrationMeshes.size(); i++) {
+            cornerMesh.addVertices(calibrationMeshes[i].getVertices());
+        }
+    }
+    return mergeNearbyVertices(cornerMesh, selectionMergeTolerance);
 }
 
 void ofApp::save(string name){
@@ -1233,6 +1230,8 @@ bool ofApp::imGui()
             ImGui::PopFont();
             ImGui::TextUnformatted("(c) den frie vilje 2018 for Arup");
             ImGui::Text("FPS %.3f", ofGetFrameRate());
+            auto totalLatency = tracking.getLatency().summarize(LatencyStats::TOTAL);
+            ImGui::Text("Latency %.1f / %.1f / %.1f ms", totalLatency.p50, totalLatency.p95, totalLatency.p99);
             int logoSize = 60;
             ImGui::SetColumnOffset(1, ImGui::GetWindowContentRegionMax().x - (logoSize + 7));
             ImGui::NextColumn();
@@ -1305,6 +1304,54 @@ bool ofApp::imGui()
             
             ofxImGui::AddGroup(pgTracking, mainSettings);
             
+            if(tracking.isRecording()){
+                if(ImGui::Button("Stop Recording")){
+                    tracking.stopRecording();
+                }
+            } else if(ImGui::Button("Record Depth")){
+                ofDirectory::createDirectory("recordings", true, true);
+                tracking.startRecording("recordings/" + ofGetTimestampString("%Y-%m-%d-%H-%M-%S") + ".rawdepth");
+            }
+            
+            if(tracking.isRemote()){
+                if(tracking.isRemoteRunning()){
+                    ImGui::Text("Remote tracker %d, frame %llu", tracking.getRemotePid(), tracking.getFrame().frameNumber);
+                } else {
+                    ImGui::TextUnformatted("Remote tracker not running");
+                }
+            } else {
+                ImGui::Text("Sensors %d of %d", tracking.getFrame().sensorsFused, int(tracking.getNumSensors()));
+            }
+            ImGui::Text("Background frames %llu", tracking.getFrame().backgroundFrames);
+            ImGui::SameLine();
+            if(ImGui::Button("Reset Background")){
+                tracking.resetBackground();
+            }
+            
+            if(trackingLag.isValid()){
+                ImGui::Text("Smoothing delay %.0f ms", trackingLag.get() * 1000.0);
+            } else {
+                ImGui::TextUnformatted("Smoothing delay - (walk to measure)");
+            }
+            
+            if(ImGui::TreeNode("Latency p50 / p95 / p99")){
+                auto & latency = tracking.getLatency();
+                for(int s = 0; s < LatencyStats::STAGE_COUNT; s++){
+                    auto summary = latency.summarize(LatencyStats::Stage(s));
+                    ImGui::Text("%-10s %6.1f %6.1f %6.1f ms", LatencyStats::getStageName(s), summary.p50, summary.p95, summary.p99);
+                }
+                if(ImGui::Button("Save Latency CSV")){
+                    ofDirectory::createDirectory("latency", true, true);
+                    string path = ofToDataPath("latency/" + ofGetTimestampString("%Y-%m-%d-%H-%M-%S") + ".csv", true);
+                    if(latency.saveCsv(path)){
+                        ofLogNotice("Latency") << "saved " << path;
+                    } else {
+                        ofLogError("Latency") << "could not write " << path;
+                    }
+                }
+                ImGui::TreePop();
+            }
+            
             ofxImGui::AddGroup(mViewFront->pg, mainSettings);
             
             ofxImGui::AddGroup(mViewSide->pg, mainSettings);
@@ -1380,6 +1427,10 @@ bool ofApp::imGui()
                                 }
                             }
                             ImGui::PopItemWidth();
+                            if(p->calibrationReady() && p->mapamok.solveTier != PoseSolver::NONE){
+                                ImGui::Text("%.1f px %s%s", p->residual, PoseSolver::getTierName(p->mapamok.solveTier), p->solver.isSolving() ? " ..." : "");
+                                ImGui::SameLine();
+                            }
                             ofxImGui::AddParameter(p->pCalibrationDrawScales);
                             ImGui::SameLine();
                             ImGui::PushItemWidth(100);
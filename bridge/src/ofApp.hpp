@@ -16,9 +16,13 @@
 #include "ofxPBR.h"
 #include "World.hpp"
 #include "ViewPlane.hpp"
+#include "PosePredictor.hpp"
 #include "ofxChoreograph.h"
-#include "MeshTracker.hpp"
-#include <librealsense2/rs.hpp>
+#include "TrackingThread.hpp"
+#include "WorkerPool.hpp"
+#include "PointCloudBuffer.hpp"
+#include "CornerMeshCache.hpp"
+#include <future>
 #include <iostream>
 #include <type_traits>
 
@@ -76,6 +80,7 @@ public:
     
     void setup();
     void update();
+    void exit();
     void extracted();
     
     void draw();
@@ -91,6 +96,7 @@ public:
     
     void loadRenderModel(string filename);
     void loadNodeModel(string filename);
+    ofMesh bakeCornerMesh(const vector<ofMesh> & calibrationMeshes) const;
     
     void save(string name);
     void load(string name);
@@ -161,7 +167,21 @@ public:
     
     ofParameter<glm::vec3> pTrackingStartPosition{ "Start Position", glm::vec3(0.,0.,0.), glm::vec3(-10.,-10.,-10.), glm::vec3(10.,10.,10.)};
 
-    ofParameterGroup pgTracking{"Tracking", pTrackingEnabled, pTrackingVisible, pTrackingTimeout, pHeadPosition, pHeadOffset, pTrackingCameraPosition, pTrackingCameraRotation, pTrackingBoxPosition, pTrackingBoxRotation, pTrackingBoxSize, pTriggerBoxPosition, pTriggerBoxRotation, pTriggerBoxSize, pTrackingStartPosition};
+    ofParameter<string> pTrackingSource{ "Source", ""}; // empty for live camera, or a .bag or raw depth recording
+    ofParameter<bool> pTrackingRealtime{ "Realtime Playback", true};
+    ofParameter<int> pTrackingMaxHeads{ "Max Heads", 3, 1, 32};
+    ofParameter<bool> pTrackingBackground{ "Background Subtraction", true};
+    ofParameter<bool> pTrackingDetection{ "Detection", true};
+    ofParameter<float> pTrackingMinHeadHeight{ "Min Head Height", 1.0, 0.0, 2.5};
+    ofParameter<bool> pTrackingPrediction{ "Prediction", true};
+    ofParameter<float> pTrackingPredictionHorizon{ "Prediction Horizon", 0.033, 0.0, 0.15}; // s from update to scanout
+    ofParameter<bool> pTrackingOneEuro{ "One Euro Smoothing", false}; // instead of the Kalman filters
+    ofParameter<float> pTrackingOneEuroMinCutoff{ "One Euro Min Cutoff", 1.0, 0.05, 10.0}; // Hz
+    ofParameter<float> pTrackingOneEuroBeta{ "One Euro Beta", 2.0, 0.0, 20.0}; // Hz per m/s
+    ofParameter<float> pTrackingSyncWindow{ "Sync Window", 0.010, 0.0, 0.05}; // s, frames of several sensors this close are fused
+    ofParameter<bool> pTrackingRemote{ "Remote", false}; // heads from a headtrack-service process instead of the sensors here
+
+    ofParameterGroup pgTracking{"Tracking", pTrackingEnabled, pTrackingVisible, pTrackingSource, pTrackingRealtime, pTrackingMaxHeads, pTrackingBackground, pTrackingDetection, pTrackingMinHeadHeight, pTrackingPrediction, pTrackingPredictionHorizon, pTrackingOneEuro, pTrackingOneEuroMinCutoff, pTrackingOneEuroBeta, pTrackingSyncWindow, pTrackingRemote, pTrackingTimeout, pHeadPosition, pHeadOffset, pTrackingCameraPosition, pTrackingCameraRotation, pTrackingBoxPosition, pTrackingBoxRotation, pTrackingBoxSize, pTriggerBoxPosition, pTriggerBoxRotation, pTriggerBoxSize, pTrackingStartPosition};
 
     ofParameter<float> pAudioWindVolume{"Wind volume", 1.0, 0.0, 1.0};
     ofParameter<float> pAudioVideoVolume{"Video volume", 1.0, 0.0, 1.0};
@@ -198,12 +218,17 @@ public:
     const int cornerMinimum = 6;
     const float mergeTolerance = .001;
     const float selectionMergeTolerance = .001;
-    ofVboMesh calibrationMesh, calibrationCornerMesh;
+    ofVboMesh calibrationCornerMesh;
+    std::future<ofMesh> cornerMeshBake;
+    string cornerMeshCachePath;
+    uint64_t cornerMeshKey = 0;
     
     // PROJECTORS
     glm::vec2 projectionResolution = {1920, 1200};
     
     map<string, shared_ptr<Projector> > mProjectors;
+    WorkerPool calibrationPool;
+    vector<Projector*> calibratingProjectors;
     
     ofRectangle mViewPortFront;
     shared_ptr<Projector> mProjectorFront;
@@ -253,7 +278,7 @@ public:
     
     ofFbo::Settings defaultFboSettings;
     
-    ofAutoShader shader, videoShader, tonemap, fxaa;
+    ofAutoShader shader, videoShader, tonemap, fxaa, pointShader;
     
     function<void()> scene;
     
@@ -271,28 +296,19 @@ public:
 
     // TRACKING
     
-    rs2::pipeline pipe;
-    rs2::device device;
-    rs2::pipeline_profile selection;
-    rs2::colorizer color_map;
-    rs2::frame colored_depth;
-    rs2::frame colored_filtered;
-    rs2_intrinsics intrinsics;
-    
-    rs2::decimation_filter dec_filter;
-    rs2::spatial_filter spat_filter;
-    rs2::temporal_filter temp_filter;
-    
-    rs2::points points;
-    rs2::pointcloud pc;
+    TrackingThread tracking;
     
-    ofMesh trackingMesh;
+    PointCloudBuffer trackingPoints;
         
     ofCamera trackingCamera;
     
-    ofxCv::KalmanPosition trackingKalman;
+    KalmanBank<2> trackingKalman;
+    PosePredictor headPredictor;
+    SmoothingLag trackingLag; // from raw to pHeadPosition, before prediction
+    uint64_t headArrivalMicros = 0; // when the depth frame behind pHeadPosition arrived
+    uint64_t headPoseMicros = 0; // when pHeadPosition was last set from tracking
+    int headPredictorTrackId = 0;
 
-    MeshTracker tracker;
     ofBoxPrimitive triggerBox;
 
 };
@@ -15,49 +15,7 @@ void ofApp::setup(){
     
     mesh.setMode(OF_PRIMITIVE_POINTS);
 
-    rs2::config cfg;
-    cfg.enable_stream(RS2_STREAM_DEPTH, 848, 480, RS2_FORMAT_ANY, 60);
-    selection = pipe.start(cfg);
-    
-    // Find first depth sensor (devices can have zero or more then one)
-    auto depth_sensor = selection.get_device().first<rs2::depth_sensor>();
-    if (depth_sensor.supports(RS2_OPTION_EMITTER_ENABLED))
-    {
-        depth_sensor.set_option(RS2_OPTION_EMITTER_ENABLED, 1.f); // Enable emitter
-    }
-    if (depth_sensor.supports(RS2_OPTION_LASER_POWER))
-    {
-        // Query min and max values:
-        auto range = depth_sensor.get_option_range(RS2_OPTION_LASER_POWER);
-        depth_sensor.set_option(RS2_OPTION_LASER_POWER, range.max); // Set max power
-    }
-
-
-    auto scale =  depth_sensor.get_depth_scale();
-    
-    auto stream = pipe.get_active_profile().get_stream(RS2_STREAM_DEPTH);
-    if (auto video_stream = stream.as<rs2::video_stream_profile>())
-    {
-        try
-        {
-            //If the stream is indeed a video stream, we can now simply call get_intrinsics()
-            intrinsics = video_stream.get_intrinsics();
-            
-            auto principal_point = std::make_pair(intrinsics.ppx, intrinsics.ppy);
-            auto focal_length = std::make_pair(intrinsics.fx, intrinsics.fy);
-            rs2_distortion model = intrinsics.model;
-            
-            std::cout << "Principal Point         : " << principal_point.first << ", " << principal_point.second << std::endl;
-            std::cout << "Focal Length            : " << focal_length.first << ", " << focal_length.second << std::endl;
-            std::cout << "Distortion Model        : " << model << std::endl;
-            std::cout << "Distortion Coefficients : [" << intrinsics.coeffs[0] << "," << intrinsics.coeffs[1] << "," <<
-            intrinsics.coeffs[2] << "," << intrinsics.coeffs[3] << "," << intrinsics.coeffs[4] << "]" << std::endl;
-        }
-        catch (const std::exception& e)
-        {
-            std::cerr << "Failed to get intrinsics for the given stream. " << e.what() << std::endl;
-        }
-    }
+    openSource(make_shared<LiveDepthSource>());
 
     tracker.set(4, 2, 4);
     tracker.setGlobalPosition(0, 1, 0);
@@ -81,11 +39,46 @@ void ofApp::setup(){
 
 }
 
+void ofApp::openSource(shared_ptr<DepthSource> newSource){
+    
+    if(!newSource->open()){
+        ofLogError("ofApp") << "could not open " << newSource->getDescription();
+        return;
+    }
+    source = newSource;
+    
+    intrinsics = source->getIntrinsics();
+    
+    auto principal_point = std::make_pair(intrinsics.ppx, intrinsics.ppy);
+    auto focal_length = std::make_pair(intrinsics.fx, intrinsics.fy);
+    rs2_distortion model = intrinsics.model;
+    
+    std::cout << "Source                  : " << source->getDescription() << std::endl;
+    std::cout << "Principal Point         : " << principal_point.first << ", " << principal_point.second << std::endl;
+    std::cout << "Focal Length            : " << focal_length.first << ", " << focal_length.second << std::endl;
+    std::cout << "Distortion Model        : " << model << std::endl;
+    std::cout << "Distortion Coefficients : [" << intrinsics.coeffs[0] << "," << intrinsics.coeffs[1] << "," <<
+    intrinsics.coeffs[2] << "," << intrinsics.coeffs[3] << "," << intrinsics.coeffs[4] << "]" << std::endl;
+}
+
+void ofApp::loadBagFile(string path){
+    // plays rosbags as well as raw depth recordings from the bridge app
+    openSource(makeDepthSource(path));
+}
+
+void ofApp::dragEvent(ofDragInfo dragInfo){
+    if(dragInfo.files.size() > 0){
+        loadBagFile(dragInfo.files.front());
+    }
+}
+
 void ofApp::update(){
 
-    // Get depth data from camera
-    auto frames = pipe.wait_for_frames();
-    auto depth = frames.get_depth_frame();
+    if(!source) return;
+    
+    // Get depth data from camera or recording
+    rs2::frame depth;
+    if(!source->waitForFrame(depth)) return;
     
     rs2::frame filtered = depth;
     // Note the concatenation of output/input frame to build up a chain
@@ -100,31 +93,41 @@ void ofApp::update(){
     int n = points.size();
     if(n!=0){
         const rs2::vertex * vs = points.get_vertices();
+        x.clear();
+        y.clear();
+        z.clear();
         for(int i=0; i<n; i++){
             if(vs[i].z){
                 const rs2::vertex v = vs[i];
-                glm::vec3 v3(v.x,-v.y,-v.z);
-                mesh.addVertex(v3);
-                int wasAdded = tracker.addVertex(v3);
-                
-                ofFloatColor c;
-                if(wasAdded == 0){
-                    c = ofFloatColor::lightGray;
-                } else if (wasAdded == 1){
-                    c = ofFloatColor::cyan;
-                } else if (wasAdded == 2){
-                    c= ofFloatColor::green;
-                } else if (wasAdded == 3){
-                    c = ofFloatColor::blueSteel;
-                }
-                
-                mesh.addColor(c);
+                x.push_back(v.x);
+                y.push_back(-v.y);
+                z.push_back(-v.z);
             }
         }
+        labels.resize(x.size());
+        tracker.addVertices(x.data(), y.data(), z.data(), labels.data(), x.size());
+        for(size_t i=0; i<x.size(); i++){
+            mesh.addVertex(glm::vec3(x[i], y[i], z[i]));
+
+            ofFloatColor c;
+            int wasAdded = labels[i];
+            if(wasAdded == 0){
+                c = ofFloatColor::lightGray;
+            } else if (wasAdded == 1){
+                c = ofFloatColor::cyan;
+            } else if (wasAdded == 2){
+                c= ofFloatColor::green;
+            } else if (wasAdded == 3){
+                c = ofFloatColor::blueSteel;
+            }
+
+            mesh.addColor(c);
+        }
         tracker.update();
     }
-    cam.orbitDeg(ofGetElapsedTimef()*10.0, -45., 3.0, tracker.heads.front());
-    cam.setTarget(tracker.heads.front());
+    auto head = tracker.getGlobalPosition(tracker.getHead(0));
+    cam.orbitDeg(ofGetElapsedTimef()*10.0, -45., 3.0, head);
+    cam.setTarget(head);
     cam.setNearClip(0.1);
 }
 
@@ -2,7 +2,8 @@
 
 #include "ofMain.h"
 #include <librealsense2/rs.hpp>
-#include "tracker.hpp"
+#include "../../bridge/src/DepthSource.hpp"
+#include "../../bridge/src/MeshTracker.hpp"
 
 class ofApp : public ofBaseApp{
 public:
@@ -10,11 +11,12 @@ public:
     void update();
     void draw();
     
+    void dragEvent(ofDragInfo dragInfo);
+    
     void loadBagFile(string path);
+    void openSource(shared_ptr<DepthSource> newSource);
     
-    rs2::pipeline pipe;
-    rs2::device device;
-    rs2::pipeline_profile selection;
+    shared_ptr<DepthSource> source;
     rs2::colorizer color_map;
     rs2::frame colored_depth;
     rs2::frame colored_filtered;
@@ -27,6 +29,8 @@ public:
     rs2::points points;
     rs2::pointcloud pc;
     
+    vector<float> x, y, z;
+    vector<uint8_t> labels;
     ofVboMesh mesh;
     ofEasyCam cam;
     
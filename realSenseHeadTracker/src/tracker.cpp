@@ -1,9 +0,0 @@
-//
-//  tracker.cpp
-//  exampleLiveCamera
-//
-//  Created by ole on 24/09/2018.
-//
-
-#include "tracker.hpp"
-
@@ -0,0 +1,66 @@
+//
+//  PipelineOptions.hpp
+//  tracking
+//
+//  Command line options for HeadPipeline::Settings, shared by the tools.
+//
+
+#pragma once
+
+#include "HeadPipeline.hpp"
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+static const char * pipelineUsage =
+    "  --camera x,y,z,rx,ry,rz      depth camera pose, m and euler degrees\n"
+    "  --box x,y,z,rx,ry,rz,w,h,d   tracking box pose and size\n"
+    "  --start x,y,z                where ready heads wait\n"
+    "  --heads n                    heads to track, 3\n"
+    "  --min-head-height m          lowest head that is detected, 1.0\n"
+    "  --one-euro                   one euro filters instead of the Kalman filters\n"
+    "  --background                 learn the background while nobody is tracked\n";
+
+static bool parseFloats(const std::string & text, float * values, int count){
+    std::stringstream stream(text);
+    std::string item;
+    int i = 0;
+    while(std::getline(stream, item, ',')){
+        if(i == count) return false;
+        char * end = nullptr;
+        values[i++] = strtof(item.c_str(), &end);
+        if(end == item.c_str()) return false;
+    }
+    return i == count;
+}
+
+// returns true if argv[i] was one of the options above, i is moved past its value
+static bool parsePipelineOption(int argc, char ** argv, int & i, HeadPipeline::Settings & settings){
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    float v[9];
+    if(arg == "--camera" && hasValue && parseFloats(argv[i + 1], v, 6)){
+        settings.cameraPosition = {v[0], v[1], v[2]};
+        settings.cameraRotation = {v[3], v[4], v[5]};
+    } else if(arg == "--box" && hasValue && parseFloats(argv[i + 1], v, 9)){
+        settings.boxPosition = {v[0], v[1], v[2]};
+        settings.boxRotation = {v[3], v[4], v[5]};
+        settings.boxSize = {v[6], v[7], v[8]};
+    } else if(arg == "--start" && hasValue && parseFloats(argv[i + 1], v, 3)){
+        settings.startPosition = {v[0], v[1], v[2]};
+    } else if(arg == "--heads" && hasValue){
+        settings.maxHeads = atoi(argv[i + 1]);
+    } else if(arg == "--min-head-height" && hasValue){
+        settings.minHeadHeight = atof(argv[i + 1]);
+    } else if(arg == "--one-euro"){
+        settings.oneEuroSmoothing = true;
+        return true;
+    } else if(arg == "--background"){
+        settings.backgroundLearning = true;
+        return true;
+    } else {
+        return false;
+    }
+    i++;
+    return true;
+}
@@ -0,0 +1,173 @@
+//
+//  batch.cpp
+//  headtrack-batch
+//
+//  Runs the head tracking over raw depth recordings, as fast as the
+//  recordings can be read, and writes a trajectory per recording. Every
+//  recording gets a core of its own and its own tracker.
+//
+
+#include "RawDepthFile.hpp"
+#include "HeadPipeline.hpp"
+#include "PipelineOptions.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Options {
+    HeadPipeline::Settings pipeline;
+    int threads = 0; // recordings at once, 0 for one per core
+    std::string outputDirectory; // empty for next to the recordings
+    std::vector<std::string> recordings;
+};
+
+static void printUsage(){
+    std::cerr <<
+    "usage: headtrack-batch [options] recording.rawdepth ...\n"
+    "\n" << pipelineUsage <<
+    "  --threads n                  recordings processed at once, one per core\n"
+    "  --out directory              where the trajectories go, next to the recordings\n"
+    "\n"
+    "Writes <recording>.csv with time,frame,trackId,state,x,y,z for every\n"
+    "tracking or lost head and frame, in world space.\n";
+}
+
+static bool parseOptions(int argc, char ** argv, Options & options){
+    for(int i = 1; i < argc; i++){
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if(parsePipelineOption(argc, argv, i, options.pipeline)){
+            continue;
+        } else if(arg == "--threads" && hasValue){
+            options.threads = atoi(argv[++i]);
+        } else if(arg == "--out" && hasValue){
+            options.outputDirectory = argv[++i];
+        } else if(arg.compare(0, 2, "--") == 0){
+            std::cerr << "headtrack-batch: bad option " << arg << "\n";
+            return false;
+        } else {
+            options.recordings.push_back(arg);
+        }
+    }
+    return !options.recordings.empty();
+}
+
+static std::string outputPath(const Options & options, const std::string & recording){
+    std::string path = recording;
+    const size_t slash = path.find_last_of('/');
+    const size_t dot = path.find_last_of('.');
+    if(dot != std::string::npos && (slash == std::string::npos || slash < dot)) path.erase(dot);
+    if(!options.outputDirectory.empty()){
+        path = options.outputDirectory + "/" + (slash == std::string::npos ? path : path.substr(slash + 1));
+    }
+    return path + ".csv";
+}
+
+struct Result {
+    uint32_t frames = 0;
+    int tracks = 0;
+    double seconds = 0;
+};
+
+// on recording time, so the same recording always gives the same trajectory
+static bool processRecording(const Options & options, const std::string & recording, Result & result, std::string & error){
+
+    RawDepthReader reader;
+    if(!reader.open(recording)){
+        error = reader.getError();
+        return false;
+    }
+    const std::string path = outputPath(options, recording);
+    std::ofstream out(path);
+    if(!out){
+        error = "could not write " + path;
+        return false;
+    }
+    out << "time,frame,trackId,state,x,y,z\n";
+
+    HeadPipeline pipeline;
+    pipeline.setup(options.pipeline, 0); // the other cores run other recordings
+    const auto & tracker = pipeline.getTracker();
+    const float depthScale = reader.getHeader().depthScale;
+
+    const double firstTimestamp = reader.getFrame(0)->timestamp;
+    for(uint32_t f = 0; f < reader.getFrameCount(); f++){
+        auto frameHeader = reader.getFrame(f);
+        const float time = (frameHeader->timestamp - firstTimestamp) / 1000.0;
+        pipeline.process(RawDepthReader::getDepth(frameHeader), reader.getIntrinsics(), depthScale, frameHeader->frameNumber, frameHeader->timestamp, time);
+        for(auto & event : tracker.getEvents()){
+            if(event.type == HeadTracker::Event::NEW) result.tracks++;
+        }
+
+        for(size_t i = 0; i < tracker.size(); i++){
+            auto & head = tracker.getHead(i);
+            if(!head.isTrackingOrLost()) continue;
+            const glm::vec3 p = tracker.getGlobalPosition(head);
+            out << time << "," << frameHeader->frameNumber << "," << head.trackId << "," << (head.isTracking() ? "tracking" : "lost") << "," << p.x << "," << p.y << "," << p.z << "\n";
+        }
+        result.frames++;
+    }
+    result.seconds = (reader.getFrame(reader.getFrameCount() - 1)->timestamp - firstTimestamp) / 1000.0;
+    if(!out){
+        error = "could not write " + path;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char ** argv){
+
+    Options options;
+    if(!parseOptions(argc, argv, options)){
+        printUsage();
+        return 1;
+    }
+
+    int threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<int>(threads, options.recordings.size());
+
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next {0};
+    std::atomic<int> failed {0};
+    std::atomic<uint64_t> totalFrames {0};
+    std::mutex printMutex;
+
+    auto work = [&]{
+        for(size_t r = next++; r < options.recordings.size(); r = next++){
+            const auto & recording = options.recordings[r];
+            const auto recordingStart = std::chrono::steady_clock::now();
+            Result result;
+            std::string error;
+            const bool ok = processRecording(options, recording, result, error);
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - recordingStart).count();
+            std::lock_guard<std::mutex> lock(printMutex);
+            if(ok){
+                totalFrames += result.frames;
+                std::printf("%s: %u frames, %.1f s of depth, %d tracks, %.0f fps\n", recording.c_str(), result.frames, result.seconds, result.tracks, result.frames / std::max(elapsed, 1e-6));
+            } else {
+                failed++;
+                std::fprintf(stderr, "%s: %s\n", recording.c_str(), error.c_str());
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(int t = 1; t < threads; t++){
+        workers.emplace_back(work);
+    }
+    work();
+    for(auto & worker : workers){
+        worker.join();
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%llu frames in %.1f s on %d threads, %.0f fps\n", (unsigned long long)totalFrames, elapsed, threads, totalFrames / std::max(elapsed, 1e-6));
+    return failed == 0 ? 0 : 1;
+}
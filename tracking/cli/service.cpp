@@ -0,0 +1,280 @@
+//
+//  service.cpp
+//  headtrack-service
+//
+//  Runs the head tracking as a process of its own and publishes the heads
+//  through a HeadPoseRing, for the bridge app to read with Tracking > Remote.
+//  It can be stopped and started again while the app keeps running.
+//
+
+#include "RawDepthFile.hpp"
+#include "HeadPipeline.hpp"
+#include "HeadPoseRing.hpp"
+#include "PipelineOptions.hpp"
+#ifdef HEADTRACKING_REALSENSE
+#include <librealsense2/rs.hpp>
+#endif
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+struct Options {
+    HeadPipeline::Settings pipeline;
+    int threads = -1;
+    std::string ring = "/oresund-heads";
+    bool live = false;
+    std::string serial; // empty for the first camera found
+    std::string recording;
+};
+
+static void printUsage(){
+    std::cerr <<
+    "usage: headtrack-service [options] recording.rawdepth\n"
+    "       headtrack-service [options] --live [serial]\n"
+    "\n" << pipelineUsage <<
+    "  --threads n                  tracker threads, all cores\n"
+    "  --ring name                  shared memory the heads go to, /oresund-heads\n"
+    "\n"
+    "Recordings are played in real time, over and over. Settings the app\n"
+    "writes into the ring replace the ones given here.\n";
+}
+
+static bool parseOptions(int argc, char ** argv, Options & options){
+    for(int i = 1; i < argc; i++){
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if(parsePipelineOption(argc, argv, i, options.pipeline)){
+            continue;
+        } else if(arg == "--threads" && hasValue){
+            options.threads = atoi(argv[++i]);
+        } else if(arg == "--ring" && hasValue){
+            options.ring = argv[++i];
+        } else if(arg == "--live"){
+            options.live = true;
+            if(hasValue && argv[i + 1][0] != '-') options.serial = argv[++i];
+        } else if(arg.compare(0, 2, "--") == 0){
+            std::cerr << "headtrack-service: bad option " << arg << "\n";
+            return false;
+        } else if(options.recording.empty()){
+            options.recording = arg;
+        } else {
+            return false;
+        }
+    }
+    return options.live != !options.recording.empty();
+}
+
+// one depth image at a time, from wherever it comes
+class DepthInput {
+public:
+    virtual ~DepthInput() {}
+    virtual bool open(std::string & error) = 0;
+    // blocks until the next image, false if there will be none
+    virtual bool next() = 0;
+
+    const uint16_t * depth = nullptr;
+    rs2_intrinsics intrinsics;
+    float depthScale = 0.001;
+    unsigned long long frameNumber = 0;
+    double timestamp = 0; // ms, camera clock
+};
+
+// a recording paced the way it was recorded, numbers and timestamps keep
+// going up when it starts over
+class RecordingInput : public DepthInput {
+public:
+    RecordingInput(const std::string & path) : path(path) {}
+
+    bool open(std::string & error) override {
+        if(!reader.open(path)){
+            error = reader.getError();
+            return false;
+        }
+        intrinsics = reader.getIntrinsics();
+        depthScale = reader.getHeader().depthScale;
+        const auto first = reader.getFrame(0);
+        const auto last = reader.getFrame(reader.getFrameCount() - 1);
+        const double frameMs = reader.getFrameCount() > 1 ? (last->timestamp - first->timestamp) / (reader.getFrameCount() - 1) : 33.3;
+        loopMs = last->timestamp - first->timestamp + frameMs;
+        loopFrames = last->frameNumber - first->frameNumber + 1;
+        start = headPoseClock();
+        return true;
+    }
+
+    bool next() override {
+        if(index == reader.getFrameCount()){
+            index = 0;
+            loop++;
+        }
+        const auto first = reader.getFrame(0);
+        const auto frame = reader.getFrame(index++);
+        timestamp = frame->timestamp + loop * loopMs;
+        frameNumber = frame->frameNumber + loop * loopFrames;
+        depth = RawDepthReader::getDepth(frame);
+        const double due = start + (timestamp - first->timestamp) / 1000.0;
+        const double wait = due - headPoseClock();
+        if(wait > 0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        return true;
+    }
+
+private:
+    std::string path;
+    RawDepthReader reader;
+    uint32_t index = 0;
+    unsigned long long loop = 0;
+    unsigned long long loopFrames = 0;
+    double loopMs = 0;
+    double start = 0;
+};
+
+#ifdef HEADTRACKING_REALSENSE
+// the same stream the bridge app asks its cameras for
+class LiveInput : public DepthInput {
+public:
+    LiveInput(const std::string & serial) : serial(serial) {}
+
+    bool open(std::string & error) override {
+        try {
+            rs2::config cfg;
+            if(!serial.empty()){
+                cfg.enable_device(serial);
+            }
+            cfg.enable_stream(RS2_STREAM_DEPTH, 848, 480, RS2_FORMAT_ANY, 60);
+            auto selection = pipe.start(cfg);
+            auto sensor = selection.get_device().first<rs2::depth_sensor>();
+            if(sensor.supports(RS2_OPTION_EMITTER_ENABLED)) sensor.set_option(RS2_OPTION_EMITTER_ENABLED, 1.f);
+            if(sensor.supports(RS2_OPTION_ENABLE_AUTO_EXPOSURE)) sensor.set_option(RS2_OPTION_ENABLE_AUTO_EXPOSURE, 1.f);
+            if(sensor.supports(RS2_OPTION_LASER_POWER)) sensor.set_option(RS2_OPTION_LASER_POWER, sensor.get_option_range(RS2_OPTION_LASER_POWER).max);
+            depthScale = sensor.get_depth_scale();
+            intrinsics = selection.get_stream(RS2_STREAM_DEPTH).as<rs2::video_stream_profile>().get_intrinsics();
+        } catch (const rs2::error & e) {
+            error = std::string("could not start camera: ") + e.what();
+            return false;
+        }
+        return true;
+    }
+
+    bool next() override {
+        try {
+            frame = pipe.wait_for_frames(1000).get_depth_frame();
+        } catch (const rs2::error & e) {
+            std::cerr << "headtrack-service: " << e.what() << "\n";
+            return false;
+        }
+        depth = (const uint16_t*)frame.get_data();
+        frameNumber = frame.get_frame_number();
+        timestamp = frame.get_timestamp();
+        return true;
+    }
+
+private:
+    std::string serial;
+    rs2::pipeline pipe;
+    rs2::frame frame; // kept until the next one, the pipeline reads it in place
+};
+#endif
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void requestStop(int){
+    stopRequested = 1;
+}
+
+static HeadPose toPose(const HeadTracker & tracker, const HeadTrack & head){
+    HeadPose pose;
+    pose.id = head.id;
+    pose.trackId = head.trackId;
+    pose.state = head.state;
+    pose.radius = head.radius;
+    pose.firstTimeTracking = head.firstTimeTracking;
+    pose.lastTimeTracking = head.lastTimeTracking;
+    pose.lastTrackPointWeighedCount = head.lastTrackPointWeighedCount;
+    pose.globalPosition = tracker.getGlobalPosition(head);
+    pose.rawGlobalPosition = head.rawGlobalPosition;
+    pose.globalFloorPoint = tracker.getGlobalFloorPoint(head);
+    return pose;
+}
+
+int main(int argc, char ** argv){
+
+    Options options;
+    if(!parseOptions(argc, argv, options)){
+        printUsage();
+        return 1;
+    }
+
+    std::unique_ptr<DepthInput> input;
+    if(options.live){
+#ifdef HEADTRACKING_REALSENSE
+        input.reset(new LiveInput(options.serial));
+#else
+        std::cerr << "headtrack-service: built without librealsense2, no live cameras\n";
+        return 1;
+#endif
+    } else {
+        input.reset(new RecordingInput(options.recording));
+    }
+    std::string error;
+    if(!input->open(error)){
+        std::cerr << "headtrack-service: " << error << "\n";
+        return 1;
+    }
+
+    HeadPoseRing ring;
+    if(!ring.create(options.ring)){
+        std::cerr << "headtrack-service: could not create shared memory " << options.ring << "\n";
+        return 1;
+    }
+
+    // the app's settings win, and the trackIds carry on where the last run left them
+    HeadPipeline::Settings settings = options.pipeline;
+    ring.readSettings(settings);
+    settings.maxHeads = std::min<int>(std::max(settings.maxHeads, 1), HeadKernel::maxHeads);
+    HeadPipeline pipeline;
+    pipeline.setup(settings, options.threads);
+    int lastTrackId = 0;
+    ring.readLatest([&](const HeadPoseFrame & frame){ lastTrackId = frame.lastTrackId; });
+    pipeline.getTracker().setLastTrackId(lastTrackId);
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::printf("headtrack-service: publishing to %s\n", options.ring.c_str());
+
+    const double start = headPoseClock();
+    HeadPoseFrame frame;
+    while(!stopRequested){
+        if(!input->next()){
+            if(options.live) continue; // cameras come back
+            break;
+        }
+        const double arrivalTime = headPoseClock();
+
+        if(ring.readSettings(settings)){
+            settings.maxHeads = std::min<int>(std::max(settings.maxHeads, 1), HeadKernel::maxHeads);
+            pipeline.setSettings(settings);
+        }
+        const float time = arrivalTime - start;
+        pipeline.process(input->depth, input->intrinsics, input->depthScale, input->frameNumber, input->timestamp, time);
+
+        const auto & tracker = pipeline.getTracker();
+        frame.frameNumber = input->frameNumber;
+        frame.deviceTimestamp = input->timestamp;
+        frame.arrivalTime = arrivalTime;
+        frame.trackerTime = time;
+        frame.lastTrackId = tracker.getLastTrackId();
+        frame.headCount = std::min<int>(tracker.size(), HeadKernel::maxHeads);
+        for(int i = 0; i < frame.headCount; i++){
+            frame.heads[i] = toPose(tracker, tracker.getHead(i));
+        }
+        frame.publishTime = headPoseClock();
+        ring.publish(frame);
+    }
+
+    std::printf("headtrack-service: stopped\n");
+    return 0;
+}
@@ -0,0 +1,95 @@
+//
+//  DepthBackground.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Per pixel model of the empty room, so only foreground depth gets tracked.
+//
+// Each pixel keeps a running median of its depth, moved towards every new
+// sample by at most a fixed step, and a running mean of the deviation from
+// it. A sample is foreground when it is closer than the median by more than
+// the noise band. Pixels that have never seen a valid sample count as
+// foreground until they do.
+
+class DepthBackground {
+public:
+
+    struct Settings {
+        float step = 0.004; // m the median moves per frame
+        float minBand = 0.05; // m
+        float deviationScale = 4.0;
+        float deviationRate = 0.05;
+    };
+
+    void setup(const Settings & settings){
+        this->settings = settings;
+        reset();
+    }
+
+    void reset(){
+        median.clear();
+        deviation.clear();
+        threshold.clear();
+        learnedFrames = 0;
+    }
+
+    unsigned long long getLearnedFrames() const {
+        return learnedFrames;
+    }
+
+    // learn from a frame of the empty room
+    void learn(const uint16_t * depth, int n, float depthScale){
+        allocate(n);
+        const float step = settings.step / depthScale;
+        const float minBand = settings.minBand / depthScale;
+        const float rate = settings.deviationRate;
+        const float scale = settings.deviationScale;
+        for(int i = 0; i < n; i++){
+            const float d = depth[i];
+            if(d == 0) continue;
+            float m = median[i];
+            if(m == 0){
+                m = d;
+            } else {
+                const float diff = d - m;
+                m += fminf(fmaxf(diff, -step), step);
+                deviation[i] += (fabsf(diff) - deviation[i]) * rate;
+            }
+            median[i] = m;
+            threshold[i] = uint16_t(fmaxf(m - fmaxf(minBand, scale * deviation[i]), 0.0f));
+        }
+        learnedFrames++;
+    }
+
+    // true if the raw depth sample at pixel i is in front of the background
+    bool isForeground(int i, uint16_t depth) const {
+        return depth < threshold[i];
+    }
+
+    bool isLearned(int n) const {
+        return learnedFrames > 0 && int(threshold.size()) == n;
+    }
+
+private:
+
+    void allocate(int n){
+        if(int(median.size()) == n) return;
+        median.assign(n, 0.0f);
+        deviation.assign(n, 0.0f);
+        threshold.assign(n, UINT16_MAX);
+        learnedFrames = 0;
+    }
+
+    Settings settings;
+
+    std::vector<float> median;
+    std::vector<float> deviation;
+    std::vector<uint16_t> threshold; // raw depth below which a sample is foreground
+    unsigned long long learnedFrames = 0;
+};
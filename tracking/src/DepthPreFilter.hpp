@@ -0,0 +1,230 @@
+//
+//  DepthPreFilter.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <librealsense2/rs.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Decimation, edge preserving spatial smoothing, temporal smoothing and hole
+// filling over raw uint16 depth, in place of the rs2 decimation, spatial and
+// temporal filters.
+//
+// The filters follow the librealsense ones: a median over the valid samples
+// of each block, a recursive filter left, right, down and up that only blends
+// neighbours closer than the spatial delta, and an exponential average over
+// time that keeps the last value in holes as long as the persistence mode
+// allows. Rows are decimated and smoothed sideways and downwards in one sweep
+// and smoothed upwards in a second one, once per spatial iteration, the last
+// upward sweep also smooths over time and writes out, all into buffers
+// allocated once.
+
+class DepthPreFilter {
+public:
+
+    struct Settings {
+        int magnitude = 2;
+        float spatialAlpha = 0.5;
+        float spatialDelta = 20; // depth units
+        int spatialIterations = 2; // RS2_OPTION_FILTER_MAGNITUDE of the spatial filter, 1 to 5
+        float temporalAlpha = 0.4;
+        float temporalDelta = 20; // depth units
+        int persistence = 3; // RS2_OPTION_HOLES_FILL of the temporal filter, 0 to 8
+    };
+
+    struct Image {
+        std::vector<uint16_t> data;
+        rs2_intrinsics intrinsics;
+        unsigned long long frameNumber = 0;
+        double timestamp = 0;
+    };
+
+    void setup(const Settings & settings, int ringSize = 3){
+        this->settings = settings;
+        this->settings.magnitude = std::max(1, settings.magnitude);
+        this->settings.spatialIterations = std::max(1, settings.spatialIterations);
+        ring.resize(std::max(1, ringSize));
+        ringIndex = 0;
+        history.clear(); // restart the temporal filter
+
+        // which validity histories of the last 8 frames allow filling a hole
+        static const int required[] = {0, 8, 2, 2, 2, 1, 1, 1, 0};
+        static const int window[] = {0, 8, 3, 4, 8, 2, 5, 8, 0};
+        int mode = std::min(std::max(settings.persistence, 0), 8);
+        for(int h = 0; h < 256; h++){
+            int valid = 0;
+            for(int b = 0; b < window[mode]; b++){
+                valid += (h >> b) & 1;
+            }
+            if(mode == 0) persist[h] = 0;
+            else if(mode == 8) persist[h] = 1;
+            else persist[h] = valid >= required[mode];
+        }
+    }
+
+    const Settings & getSettings() const {
+        return settings;
+    }
+
+    // filters a raw depth image into the next buffer of the ring, which stays
+    // valid until the ring comes around again, stride is in samples per row
+    const Image & process(const uint16_t * depth, int stride, const rs2_intrinsics & intrinsics, unsigned long long frameNumber = 0, double timestamp = 0){
+        const int m = settings.magnitude;
+        const int width = intrinsics.width / m;
+        const int height = intrinsics.height / m;
+        const int n = width * height;
+
+        Image & out = ring[ringIndex];
+        ringIndex = (ringIndex + 1) % ring.size();
+        out.data.resize(n);
+        out.frameNumber = frameNumber;
+        out.timestamp = timestamp;
+        out.intrinsics = intrinsics;
+        out.intrinsics.width = width;
+        out.intrinsics.height = height;
+        out.intrinsics.ppx = (intrinsics.ppx + 0.5f) / m - 0.5f;
+        out.intrinsics.ppy = (intrinsics.ppy + 0.5f) / m - 0.5f;
+        out.intrinsics.fx = intrinsics.fx / m;
+        out.intrinsics.fy = intrinsics.fy / m;
+
+        if(int(history.size()) != n){
+            spatial.assign(n, 0.0f);
+            last.assign(n, 0.0f);
+            history.assign(n, 0);
+        }
+
+        for(int i = 0; i < settings.spatialIterations; i++){
+            const bool lastIteration = i == settings.spatialIterations - 1;
+
+            // decimate the first time, left, right and down
+            for(int y = 0; y < height; y++){
+                float * row = &spatial[y * width];
+                if(i == 0) decimateRow(depth, stride, y, width, row);
+                smoothRow(row, width);
+                if(y > 0){
+                    blendRows(row, row - width, width, settings.spatialAlpha, settings.spatialDelta);
+                }
+            }
+
+            // up, temporal and out the last time
+            for(int y = height - 1; y >= 0; y--){
+                float * row = &spatial[y * width];
+                if(y < height - 1){
+                    blendRows(row, row + width, width, settings.spatialAlpha, settings.spatialDelta);
+                }
+                if(lastIteration) temporalRow(y * width, width, &out.data[y * width]);
+            }
+        }
+
+        return out;
+    }
+
+private:
+
+    // median of the valid samples in each m x m block
+    void decimateRow(const uint16_t * depth, int stride, int y, int width, float * row) const {
+        const int m = settings.magnitude;
+        uint16_t block[64];
+        for(int x = 0; x < width; x++){
+            int count = 0;
+            for(int by = 0; by < m && count < 64; by++){
+                const uint16_t * src = depth + (y * m + by) * stride + x * m;
+                for(int bx = 0; bx < m && count < 64; bx++){
+                    if(src[bx] != 0) block[count++] = src[bx];
+                }
+            }
+            if(count == 0){
+                row[x] = 0;
+            } else if(count == 1){
+                row[x] = block[0];
+            } else {
+                std::nth_element(block, block + count / 2, block + count);
+                row[x] = block[count / 2];
+            }
+        }
+    }
+
+    // recursive filter left to right and back, a dependency chain so no SIMD here
+    void smoothRow(float * row, int width) const {
+        const float alpha = settings.spatialAlpha;
+        const float delta = settings.spatialDelta;
+        for(int x = 1; x < width; x++){
+            float cur = row[x], prev = row[x - 1];
+            if(cur > 0 && prev > 0 && fabsf(cur - prev) < delta){
+                row[x] = alpha * cur + (1 - alpha) * prev;
+            }
+        }
+        for(int x = width - 2; x >= 0; x--){
+            float cur = row[x], prev = row[x + 1];
+            if(cur > 0 && prev > 0 && fabsf(cur - prev) < delta){
+                row[x] = alpha * cur + (1 - alpha) * prev;
+            }
+        }
+    }
+
+    // blend each sample with the one in the neighbouring row, all columns at once
+    static void blendRows(float * row, const float * neighbour, int width, float alpha, float delta){
+        int x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128 a = _mm_set1_ps(alpha);
+        const __m128 b = _mm_set1_ps(1 - alpha);
+        const __m128 d = _mm_set1_ps(delta);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        for(; x + 4 <= width; x += 4){
+            __m128 cur = _mm_loadu_ps(row + x);
+            __m128 prev = _mm_loadu_ps(neighbour + x);
+            __m128 diff = _mm_andnot_ps(sign, _mm_sub_ps(cur, prev));
+            __m128 blend = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(cur, zero), _mm_cmpgt_ps(prev, zero)), _mm_cmplt_ps(diff, d));
+            __m128 mixed = _mm_add_ps(_mm_mul_ps(a, cur), _mm_mul_ps(b, prev));
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(blend, mixed), _mm_andnot_ps(blend, cur)));
+        }
+#endif
+        for(; x < width; x++){
+            float cur = row[x], prev = neighbour[x];
+            if(cur > 0 && prev > 0 && fabsf(cur - prev) < delta){
+                row[x] = alpha * cur + (1 - alpha) * prev;
+            }
+        }
+    }
+
+    void temporalRow(int offset, int width, uint16_t * out){
+        const float alpha = settings.temporalAlpha;
+        const float delta = settings.temporalDelta;
+        const float * cur = &spatial[offset];
+        float * prev = &last[offset];
+        uint8_t * valid = &history[offset];
+        for(int x = 0; x < width; x++){
+            float c = cur[x];
+            float p = prev[x];
+            float v;
+            if(c > 0){
+                v = (p > 0 && fabsf(c - p) < delta) ? alpha * c + (1 - alpha) * p : c;
+            } else {
+                v = persist[valid[x]] ? p : 0;
+            }
+            valid[x] = uint8_t((valid[x] << 1) | (c > 0));
+            prev[x] = v;
+            out[x] = uint16_t(v + 0.5f);
+        }
+    }
+
+    Settings settings;
+
+    std::vector<Image> ring;
+    size_t ringIndex = 0;
+
+    std::vector<float> spatial; // working image
+    std::vector<float> last; // temporal filter output of the previous frame
+    std::vector<uint8_t> history; // valid bits of the last 8 frames, newest in bit 0
+    uint8_t persist[256];
+};
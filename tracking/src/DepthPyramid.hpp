@@ -0,0 +1,82 @@
+//
+//  DepthPyramid.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <librealsense2/rs.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Depth image at half, quarter, ... resolution, for the passes that only need
+// to see roughly where people are.
+//
+// Each level keeps the nearest valid sample of every 2 x 2 block, so a head
+// never disappears into the floor behind it and a block is only invalid when
+// all four samples are. The intrinsics are scaled along, so rays and
+// projections work on every level the same way as on the full image.
+
+class DepthPyramid {
+public:
+
+    struct Level {
+        std::vector<uint16_t> data;
+        rs2_intrinsics intrinsics;
+    };
+
+    // levels 1 to count, level 0 is the image passed in
+    void build(const uint16_t * depth, const rs2_intrinsics & intrinsics, int count){
+        levels.resize(count);
+        const uint16_t * source = depth;
+        const rs2_intrinsics * sourceIntrinsics = &intrinsics;
+        for(auto & level : levels){
+            downsample(source, *sourceIntrinsics, level);
+            source = level.data.data();
+            sourceIntrinsics = &level.intrinsics;
+        }
+    }
+
+    int size() const {
+        return levels.size();
+    }
+
+    const Level & getLevel(int level) const {
+        return levels[level - 1];
+    }
+
+private:
+
+    static void downsample(const uint16_t * in, const rs2_intrinsics & inIntrinsics, Level & out){
+        const int inWidth = inIntrinsics.width;
+        const int width = inWidth / 2;
+        const int height = inIntrinsics.height / 2;
+
+        // pixel centers sit at half pixels, so the principal point moves by a quarter
+        out.intrinsics = inIntrinsics;
+        out.intrinsics.width = width;
+        out.intrinsics.height = height;
+        out.intrinsics.fx = inIntrinsics.fx / 2;
+        out.intrinsics.fy = inIntrinsics.fy / 2;
+        out.intrinsics.ppx = (inIntrinsics.ppx + 0.5f) / 2 - 0.5f;
+        out.intrinsics.ppy = (inIntrinsics.ppy + 0.5f) / 2 - 0.5f;
+
+        // invalid samples are 0, subtracting one wraps them to the largest value
+        out.data.resize(width * height);
+        for(int y = 0; y < height; y++){
+            const uint16_t * top = in + (2 * y) * inWidth;
+            const uint16_t * bottom = top + inWidth;
+            uint16_t * row = out.data.data() + y * width;
+            for(int x = 0; x < width; x++){
+                const uint16_t a = top[2 * x] - 1;
+                const uint16_t b = top[2 * x + 1] - 1;
+                const uint16_t c = bottom[2 * x] - 1;
+                const uint16_t d = bottom[2 * x + 1] - 1;
+                row[x] = uint16_t(std::min(std::min(a, b), std::min(c, d)) + 1);
+            }
+        }
+    }
+
+    std::vector<Level> levels;
+};
@@ -0,0 +1,127 @@
+//
+//  DepthRayTable.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <librealsense2/rs.h>
+#include <librealsense2/rsutil.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// Per pixel deprojection rays for a depth image, culled against the tracking box.
+//
+// A depth sample z turns into the camera space point direction * z, the same
+// value rs2::pointcloud computes with the (x, -y, -z) flip baked in. Instead of
+// transforming every point into tracker space and testing it against the box,
+// each ray is clipped against the box once, so the box test becomes a depth
+// interval check. Pixels whose rays never cross the box are left out entirely.
+//
+// With several cameras the points of all of them go into the space of one, so
+// the directions can be given in another output space, where a sample becomes
+// origin + direction * z.
+
+class DepthRayTable {
+public:
+
+    // camera position in output space
+    glm::vec3 origin;
+    // active pixels, in image order
+    std::vector<uint32_t> pixels;
+    std::vector<glm::vec3> directions;
+    // sample is inside the box when zNear < z < zFar
+    std::vector<float> zNear;
+    std::vector<float> zFar;
+    // first active pixel of every image row, and one past the last at the end
+    std::vector<size_t> rowStart;
+
+    size_t size() const {
+        return pixels.size();
+    }
+
+    // rebuilds the table if anything it depends on changed, returns true if it did
+    bool update(const rs2_intrinsics & intrinsics, const glm::mat4 & cameraToTracker, const glm::vec3 & halfSize, float minDepth, const glm::mat4 & cameraToOutput = glm::mat4(1.0)){
+        if(built &&
+           memcmp(&intrinsics, &this->intrinsics, sizeof(rs2_intrinsics)) == 0 &&
+           cameraToTracker == this->cameraToTracker &&
+           cameraToOutput == this->cameraToOutput &&
+           halfSize == this->halfSize &&
+           minDepth == this->minDepth){
+            return false;
+        }
+        this->intrinsics = intrinsics;
+        this->cameraToTracker = cameraToTracker;
+        this->cameraToOutput = cameraToOutput;
+        this->halfSize = halfSize;
+        this->minDepth = minDepth;
+        rebuild();
+        built = true;
+        return true;
+    }
+
+private:
+
+    void rebuild(){
+        pixels.clear();
+        directions.clear();
+        zNear.clear();
+        zFar.clear();
+        rowStart.assign(intrinsics.height + 1, 0);
+
+        // camera position and the rotation/scale part, in tracker space
+        const glm::vec3 trackerOrigin = glm::vec3(cameraToTracker[3]) / cameraToTracker[3][3];
+        const glm::mat3 linear = glm::mat3(cameraToTracker);
+        const glm::mat3 output = glm::mat3(cameraToOutput);
+        origin = glm::vec3(cameraToOutput[3]) / cameraToOutput[3][3];
+
+        for(int y = 0; y < intrinsics.height; y++){
+            rowStart[y] = pixels.size();
+            for(int x = 0; x < intrinsics.width; x++){
+                float pixel[2] = {float(x), float(y)};
+                float point[3];
+                rs2_deproject_pixel_to_point(point, &intrinsics, pixel, 1.0f);
+                glm::vec3 direction(point[0], -point[1], -point[2]);
+
+                float enter = minDepth;
+                float exit = std::numeric_limits<float>::max();
+                if(!clip(trackerOrigin, linear * direction, enter, exit)) continue;
+
+                pixels.push_back(y * intrinsics.width + x);
+                directions.push_back(output * direction);
+                zNear.push_back(enter);
+                zFar.push_back(exit);
+            }
+        }
+        rowStart[intrinsics.height] = pixels.size();
+    }
+
+    // slab test of origin + z * direction against the box, narrows [enter, exit]
+    bool clip(const glm::vec3 & origin, const glm::vec3 & direction, float & enter, float & exit) const {
+        for(int i = 0; i < 3; i++){
+            if(direction[i] == 0.0f){
+                if(fabs(origin[i]) >= halfSize[i]) return false;
+                continue;
+            }
+            float a = (-halfSize[i] - origin[i]) / direction[i];
+            float b = ( halfSize[i] - origin[i]) / direction[i];
+            if(a > b) std::swap(a, b);
+            enter = std::max(enter, a);
+            exit = std::min(exit, b);
+            if(enter >= exit) return false;
+        }
+        return true;
+    }
+
+    bool built = false;
+    rs2_intrinsics intrinsics;
+    glm::mat4 cameraToTracker;
+    glm::mat4 cameraToOutput;
+    glm::vec3 halfSize;
+    float minDepth = 0.0;
+};
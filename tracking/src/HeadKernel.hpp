@@ -0,0 +1,319 @@
+//
+//  HeadKernel.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Classifies points against all heads at once, the vectorized form of
+// head::addTrackPoint as called by HeadTracker::addVertex.
+//
+// Points come in as separate x, y and z arrays in camera space, with the
+// depth each was measured at in its own sensor, which weighs it. For every
+// point the heads are tried in priority order and the first one that claims
+// it decides its label:
+//   1 inside the tracking sphere, added to that head's sums
+//   2 inside the outer sphere
+//   3 close to the line from the head down to the floor
+//   0 nothing
+// The arithmetic follows addTrackPoint operation by operation, so labels are
+// identical to the scalar code. Sums are accumulated per lane and reduced at
+// the end, so they can differ from the scalar sums in the last bits.
+
+struct HeadKernelHead {
+    // set by the caller
+    float x, y, z;
+    float radiusSquaredScaled;
+    double radiusSquaredOuter;
+    float floorX, floorY, floorZ;
+    float minFloorDistance;
+
+    // results, added to by classify
+    float sumX = 0, sumY = 0, sumZ = 0;
+    int count = 0;
+    float weighedCount = 0;
+    float radiusSquaredMax = 0;
+};
+
+class HeadKernel {
+public:
+
+    static const size_t maxHeads = 32;
+
+    // heads in the order they get to claim points, cleared sums
+    std::vector<HeadKernelHead> heads;
+
+    // per head lane accumulators, kept as plain floats so each lane type can use them
+    struct Accumulator {
+        float sumX[8], sumY[8], sumZ[8], count[8], weighed[8], radiusMax[8];
+    };
+
+    // partial sums for all heads, one per block of work
+    typedef std::vector<Accumulator> Sums;
+
+    // prepares the heads and clears their sums, call before classify
+    void begin(){
+        if(heads.size() > maxHeads) heads.resize(maxHeads);
+        prepare();
+        clear(accumulators);
+    }
+
+    void clear(Sums & sums) const {
+        sums.assign(constants.size(), Accumulator());
+    }
+
+    // classify n points against the heads whose bits are set in headMask,
+    // safe to call from several threads at once with separate labels and sums
+    void classify(const float * x, const float * y, const float * z, const float * depth, uint8_t * labels, size_t n, uint32_t headMask, Sums & sums) const {
+        size_t i = 0;
+#if defined(__AVX2__) || defined(__AVX__)
+        i = run<AvxLanes>(x, y, z, depth, labels, i, n, headMask, sums);
+#elif defined(__SSE2__) || defined(_M_X64)
+        i = run<SseLanes>(x, y, z, depth, labels, i, n, headMask, sums);
+#endif
+        run<ScalarLanes>(x, y, z, depth, labels, i, n, headMask, sums);
+    }
+
+    void classify(const float * x, const float * y, const float * z, const float * depth, uint8_t * labels, size_t n, uint32_t headMask = 0xffffffff){
+        classify(x, y, z, depth, labels, n, headMask, accumulators);
+    }
+
+    // adds partial sums to the heads, the order of calls fixes the rounding
+    void add(const Sums & sums){
+        for(size_t h = 0; h < heads.size(); h++){
+            auto & head = heads[h];
+            auto & a = sums[h];
+            for(int l = 0; l < 8; l++){
+                head.sumX += a.sumX[l];
+                head.sumY += a.sumY[l];
+                head.sumZ += a.sumZ[l];
+                head.count += int(a.count[l]);
+                head.weighedCount += a.weighed[l];
+                head.radiusSquaredMax = fmaxf(head.radiusSquaredMax, a.radiusMax[l]);
+            }
+        }
+    }
+
+    // adds the sums of the classify calls without sums of their own
+    void end(){
+        add(accumulators);
+    }
+
+private:
+
+    // head constants broadcast once per call, mirroring the scalar expressions
+    struct Constants {
+        float x, y, z;
+        float radiusSquaredScaled;
+        float radiusSquaredOuter; // first float above the double threshold
+        float floorX, floorY, floorZ;
+        float axisX, axisY, axisZ;
+        float lineDist;
+        float floorDistanceSquared;
+    };
+
+    void prepare(){
+        constants.resize(heads.size());
+        for(size_t h = 0; h < heads.size(); h++){
+            auto & head = heads[h];
+            auto & c = constants[h];
+            c.x = head.x;
+            c.y = head.y;
+            c.z = head.z;
+            c.radiusSquaredScaled = head.radiusSquaredScaled;
+            // dist < radiusSquared * 1.5 compares in double, find the float
+            // threshold that gives the same answer for every float dist
+            float outer = float(head.radiusSquaredOuter);
+            if(double(outer) < head.radiusSquaredOuter) outer = std::nextafter(outer, INFINITY);
+            c.radiusSquaredOuter = outer;
+            c.floorX = head.floorX;
+            c.floorY = head.floorY;
+            c.floorZ = head.floorZ;
+            c.axisX = head.x - head.floorX;
+            c.axisY = head.y - head.floorY;
+            c.axisZ = head.z - head.floorZ;
+            float lx = head.floorX - head.x;
+            float ly = head.floorY - head.y;
+            float lz = head.floorZ - head.z;
+            c.lineDist = lx*lx + ly*ly + lz*lz;
+            c.floorDistanceSquared = head.minFloorDistance * head.minFloorDistance;
+        }
+    }
+
+    template<typename L>
+    size_t run(const float * x, const float * y, const float * z, const float * depth, uint8_t * labels, size_t i, size_t n, uint32_t headMask, Sums & sums) const {
+        typedef typename L::F F;
+        typedef typename L::M M;
+
+        const size_t heads = constants.size();
+        const F zero = L::set(0);
+        F sumX[maxHeads], sumY[maxHeads], sumZ[maxHeads];
+        F count[maxHeads], weighed[maxHeads], radiusMax[maxHeads];
+        for(size_t h = 0; h < heads; h++){
+            sumX[h] = sumY[h] = sumZ[h] = zero;
+            count[h] = weighed[h] = radiusMax[h] = zero;
+        }
+
+        const F one = L::set(1);
+
+        for(; i + L::width <= n; i += L::width){
+            const F vx = L::load(x + i);
+            const F vy = L::load(y + i);
+            const F vz = L::load(z + i);
+            const F vd = L::load(depth + i);
+            F label = zero;
+
+            for(size_t h = 0; h < heads; h++){
+                if(((headMask >> h) & 1) == 0) continue;
+                const M open = L::eq(label, zero);
+                if(!L::any(open)) break;
+
+                const Constants & c = constants[h];
+
+                // glm::distance2(getPosition(), v)
+                const F dx = L::sub(vx, L::set(c.x));
+                const F dy = L::sub(vy, L::set(c.y));
+                const F dz = L::sub(vz, L::set(c.z));
+                const F dist = L::add(L::add(L::mul(dx, dx), L::mul(dy, dy)), L::mul(dz, dz));
+
+                const M inside = L::lt(dist, L::set(c.radiusSquaredScaled));
+                const M around = L::lt(dist, L::set(c.radiusSquaredOuter));
+
+                // distance to line towards floor
+                const F fx = L::sub(vx, L::set(c.floorX));
+                const F fy = L::sub(vy, L::set(c.floorY));
+                const F fz = L::sub(vz, L::set(c.floorZ));
+                F distV2Line;
+                if(c.lineDist == 0){
+                    distV2Line = L::add(L::add(L::mul(fx, fx), L::mul(fy, fy)), L::mul(fz, fz));
+                } else {
+                    const F ax = L::set(c.axisX);
+                    const F ay = L::set(c.axisY);
+                    const F az = L::set(c.axisZ);
+                    F t = L::div(L::add(L::add(L::mul(fx, ax), L::mul(fy, ay)), L::mul(fz, az)), L::set(c.lineDist));
+                    t = L::select(L::lt(t, zero), zero, t);
+                    t = L::select(L::gt(t, one), one, t);
+                    const F qx = L::sub(L::add(L::set(c.floorX), L::mul(t, ax)), vx);
+                    const F qy = L::sub(L::add(L::set(c.floorY), L::mul(t, ay)), vy);
+                    const F qz = L::sub(L::add(L::set(c.floorZ), L::mul(t, az)), vz);
+                    distV2Line = L::add(L::add(L::mul(qx, qx), L::mul(qy, qy)), L::mul(qz, qz));
+                }
+                const M nearLine = L::lt(distV2Line, L::set(c.floorDistanceSquared));
+
+                F headLabel = L::select(nearLine, L::set(3), zero);
+                headLabel = L::select(around, L::set(2), headLabel);
+                headLabel = L::select(inside, one, headLabel);
+                label = L::select(open, headLabel, label);
+
+                const M take = L::land(open, inside);
+                sumX[h] = L::add(sumX[h], L::select(take, vx, zero));
+                sumY[h] = L::add(sumY[h], L::select(take, vy, zero));
+                sumZ[h] = L::add(sumZ[h], L::select(take, vz, zero));
+                count[h] = L::add(count[h], L::select(take, one, zero));
+                weighed[h] = L::add(weighed[h], L::select(take, L::mul(vd, vd), zero));
+                radiusMax[h] = L::max(radiusMax[h], L::select(take, dist, zero));
+            }
+
+            alignas(32) float stored[8];
+            L::store(stored, label);
+            for(int l = 0; l < L::width; l++){
+                labels[i + l] = uint8_t(stored[l]);
+            }
+        }
+
+        for(size_t h = 0; h < heads; h++){
+            auto & a = sums[h];
+            L::accumulate(a.sumX, sumX[h]);
+            L::accumulate(a.sumY, sumY[h]);
+            L::accumulate(a.sumZ, sumZ[h]);
+            L::accumulate(a.count, count[h]);
+            L::accumulate(a.weighed, weighed[h]);
+            L::maximize(a.radiusMax, radiusMax[h]);
+        }
+        return i;
+    }
+
+    // LANES
+
+    struct ScalarLanes {
+        typedef float F;
+        typedef bool M;
+        static const int width = 1;
+        static F load(const float * p){ return *p; }
+        static void store(float * p, F a){ *p = a; }
+        static F set(float a){ return a; }
+        static F add(F a, F b){ return a + b; }
+        static F sub(F a, F b){ return a - b; }
+        static F mul(F a, F b){ return a * b; }
+        static F div(F a, F b){ return a / b; }
+        static F max(F a, F b){ return a > b ? a : b; }
+        static M lt(F a, F b){ return a < b; }
+        static M gt(F a, F b){ return a > b; }
+        static M eq(F a, F b){ return a == b; }
+        static M land(M a, M b){ return a && b; }
+        static bool any(M m){ return m; }
+        static F select(M m, F a, F b){ return m ? a : b; }
+        static void accumulate(float * a, F v){ a[0] += v; }
+        static void maximize(float * a, F v){ a[0] = fmaxf(a[0], v); }
+    };
+
+#if defined(__AVX2__) || defined(__AVX__)
+    struct AvxLanes {
+        typedef __m256 F;
+        typedef __m256 M;
+        static const int width = 8;
+        static F load(const float * p){ return _mm256_loadu_ps(p); }
+        static void store(float * p, F a){ _mm256_store_ps(p, a); }
+        static F set(float a){ return _mm256_set1_ps(a); }
+        static F add(F a, F b){ return _mm256_add_ps(a, b); }
+        static F sub(F a, F b){ return _mm256_sub_ps(a, b); }
+        static F mul(F a, F b){ return _mm256_mul_ps(a, b); }
+        static F div(F a, F b){ return _mm256_div_ps(a, b); }
+        static F max(F a, F b){ return _mm256_max_ps(a, b); }
+        static M lt(F a, F b){ return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static M gt(F a, F b){ return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static M eq(F a, F b){ return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+        static M land(M a, M b){ return _mm256_and_ps(a, b); }
+        static bool any(M m){ return _mm256_movemask_ps(m) != 0; }
+        static F select(M m, F a, F b){ return _mm256_blendv_ps(b, a, m); }
+        static void accumulate(float * a, F v){ _mm256_storeu_ps(a, _mm256_add_ps(_mm256_loadu_ps(a), v)); }
+        static void maximize(float * a, F v){ _mm256_storeu_ps(a, _mm256_max_ps(_mm256_loadu_ps(a), v)); }
+    };
+#elif defined(__SSE2__) || defined(_M_X64)
+    struct SseLanes {
+        typedef __m128 F;
+        typedef __m128 M;
+        static const int width = 4;
+        static F load(const float * p){ return _mm_loadu_ps(p); }
+        static void store(float * p, F a){ _mm_store_ps(p, a); }
+        static F set(float a){ return _mm_set1_ps(a); }
+        static F add(F a, F b){ return _mm_add_ps(a, b); }
+        static F sub(F a, F b){ return _mm_sub_ps(a, b); }
+        static F mul(F a, F b){ return _mm_mul_ps(a, b); }
+        static F div(F a, F b){ return _mm_div_ps(a, b); }
+        static F max(F a, F b){ return _mm_max_ps(a, b); }
+        static M lt(F a, F b){ return _mm_cmplt_ps(a, b); }
+        static M gt(F a, F b){ return _mm_cmpgt_ps(a, b); }
+        static M eq(F a, F b){ return _mm_cmpeq_ps(a, b); }
+        static M land(M a, M b){ return _mm_and_ps(a, b); }
+        static bool any(M m){ return _mm_movemask_ps(m) != 0; }
+        static F select(M m, F a, F b){ return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        static void accumulate(float * a, F v){ _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), v)); }
+        static void maximize(float * a, F v){ _mm_storeu_ps(a, _mm_max_ps(_mm_loadu_ps(a), v)); }
+    };
+#endif
+
+    std::vector<Constants> constants;
+    Sums accumulators;
+};
@@ -0,0 +1,268 @@
+//
+//  HeadPipeline.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "DepthPreFilter.hpp"
+#include "DepthPyramid.hpp"
+#include "DepthRayTable.hpp"
+#include "DepthBackground.hpp"
+#include "HeightMap.hpp"
+#include "HeadTracker.hpp"
+#include "PointGather.hpp"
+#include <vector>
+
+// Everything from a raw depth image of one camera to updated heads: filtering,
+// the coarse pass that finds people, the full resolution pass near heads and
+// the tracker itself.
+//
+// The stages after filtering are in Fusion, which takes any number of
+// cameras into one tracker. The bridge app's TrackingThread runs it on the
+// frames of its sensors, so the batch and service tools track exactly like
+// the app does.
+
+class HeadPipeline {
+public:
+
+    // plain data, so it can be handed between processes as it is
+    struct Settings {
+        glm::vec3 cameraPosition;
+        glm::vec3 cameraRotation; // euler degrees, like ofNode::setOrientation
+        glm::vec3 boxPosition;
+        glm::vec3 boxRotation;
+        glm::vec3 boxSize = {1., 1., 1.};
+        glm::vec3 startPosition;
+        int maxHeads = 3;
+        bool backgroundSubtraction = true;
+        bool backgroundLearning = false;
+        bool detection = true;
+        float minHeadHeight = 1.0;
+        bool oneEuroSmoothing = false;
+        OneEuroFilter::Settings oneEuro;
+    };
+
+    static const int coarseLevel = 2; // a quarter of the filtered resolution
+
+    // the transform ofNode builds from a position and euler degrees
+    static glm::mat4 poseMatrix(const glm::vec3 & position, const glm::vec3 & rotation){
+        return glm::translate(glm::mat4(1.0), position) * glm::mat4_cast(glm::quat(glm::radians(rotation)));
+    }
+
+    // what every camera is filtered with
+    static DepthPreFilter::Settings getFilterSettings(){
+        DepthPreFilter::Settings filterSettings;
+        filterSettings.magnitude = 2;
+        filterSettings.spatialAlpha = 0.95;
+        filterSettings.temporalAlpha = 0.1;
+        filterSettings.temporalDelta = 65.0;
+        filterSettings.persistence = 7;
+        return filterSettings;
+    }
+
+    // What one camera keeps from frame to frame: the ray tables of its images
+    // and the backgrounds learned for them.
+    struct View {
+        DepthRayTable rays, coarseRays;
+        DepthBackground background, coarseBackground;
+        glm::mat4 cameraToOutput = glm::mat4(1.0); // into the space the tracker works in
+
+        void setup(){
+            background.setup(DepthBackground::Settings());
+            coarseBackground.setup(DepthBackground::Settings());
+        }
+
+        void resetBackground(){
+            background.reset();
+            coarseBackground.reset();
+        }
+    };
+
+    // a filtered depth image and the pyramid built from it down to coarseLevel
+    struct ViewFrame {
+        const std::vector<uint16_t> * depth = nullptr;
+        rs2_intrinsics intrinsics;
+        const DepthPyramid * pyramid = nullptr;
+        float depthScale = 0.001;
+    };
+
+    // The stages of one frame, for any number of cameras and one tracker:
+    // begin, prepare every view, detect, gather every view, classify, and then
+    // update the tracker. Points end up in the tracker's camera space.
+    class Fusion {
+    public:
+
+        // coarsePoints keeps the coarse points even without detection, to show them
+        void begin(const HeadTracker & tracker, const Settings & settings, bool coarsePoints = false){
+            this->settings = settings;
+            gatherCoarse = settings.detection || coarsePoints;
+            this->coarsePoints.clear();
+            points.clear();
+            candidates.clear();
+
+            // learn the empty room, but never from a frame someone is tracked in
+            headsPresent = false;
+            for(auto & head : tracker.heads){
+                headsPresent |= head.isTrackingOrLost();
+            }
+        }
+
+        // the ray tables are only rebuilt when the camera, the box or the resolution changes
+        void prepare(View & view, const ViewFrame & frame, const glm::mat4 & cameraToBox, const glm::vec3 & halfSize){
+            const auto & coarse = frame.pyramid->getLevel(coarseLevel);
+            view.rays.update(frame.intrinsics, cameraToBox, halfSize, 0.5, view.cameraToOutput); // save time on skipping the closest ones
+            view.coarseRays.update(coarse.intrinsics, cameraToBox, halfSize, 0.5, view.cameraToOutput);
+
+            if(settings.backgroundLearning && !headsPresent){
+                view.background.learn(frame.depth->data(), frame.depth->size(), frame.depthScale);
+                view.coarseBackground.learn(coarse.data.data(), coarse.data.size(), frame.depthScale);
+            }
+
+            // people are found on a coarse level, only the pixels near heads are looked at in full
+            if(gatherCoarse){
+                const bool subtract = settings.backgroundSubtraction && view.coarseBackground.isLearned(coarse.data.size());
+                gatherPoints(view.coarseRays, 0, view.coarseRays.size(), coarse.data.data(), frame.depthScale, subtract ? &view.coarseBackground : nullptr, coarsePoints);
+            }
+        }
+
+        // finds people anywhere in the box and puts ready heads on them,
+        // outputToBox and outputGlobal take the tracker's camera space into the box and the world
+        void detect(HeadTracker & tracker, const glm::mat4 & outputToBox, const glm::mat4 & outputGlobal, const glm::vec3 & halfSize){
+            if(!settings.detection) return;
+            HeightMap::Settings heightSettings;
+            heightSettings.minHeight = settings.minHeadHeight;
+            heightSettings.minSeparation = tracker.headRadius * 2.0;
+            heightMap.setup(heightSettings);
+            heightMap.fill(coarsePoints.x.data(), coarsePoints.y.data(), coarsePoints.z.data(), coarsePoints.count, outputToBox, outputGlobal, halfSize);
+            for(auto & candidate : heightMap.detect()){
+                candidates.push_back(candidate.top - glm::vec3(0, tracker.headRadius, 0));
+            }
+            tracker.associate(candidates);
+        }
+
+        // the full resolution samples inside the box, near a head
+        void gather(const HeadTracker & tracker, const View & view, const ViewFrame & frame){
+            const bool subtract = settings.backgroundSubtraction && view.background.isLearned(frame.depth->size());
+            regionGather.gather(tracker, view.rays, frame.intrinsics, frame.depth->data(), frame.depthScale, subtract ? &view.background : nullptr, glm::inverse(view.cameraToOutput), points);
+        }
+
+        void classify(HeadTracker & tracker){
+            labels.resize(points.count);
+            tracker.addVertices(points.x.data(), points.y.data(), points.z.data(), labels.data(), points.count, points.depth.data());
+        }
+
+        // detected head positions of the last frame, global
+        const std::vector<glm::vec3> & getCandidates() const {
+            return candidates;
+        }
+
+        const PointSet & getCoarsePoints() const {
+            return coarsePoints;
+        }
+
+        const PointSet & getPoints() const {
+            return points;
+        }
+
+        // as returned by HeadTracker::addVertex, one per point
+        const std::vector<uint8_t> & getLabels() const {
+            return labels;
+        }
+
+    private:
+        Settings settings;
+        bool gatherCoarse = true;
+        bool headsPresent = false;
+
+        HeightMap heightMap;
+        PointSet coarsePoints, points;
+        HeadRegionGather regionGather;
+        std::vector<glm::vec3> candidates;
+        std::vector<uint8_t> labels;
+    };
+
+    // threads as for HeadTracker::setThreads
+    void setup(const Settings & settings, int threads = -1){
+        preFilter.setup(getFilterSettings());
+        view.setup();
+
+        tracker.setThreads(threads);
+        applySettings(settings);
+        tracker.setup(settings.maxHeads);
+    }
+
+    void setSettings(const Settings & settings){
+        applySettings(settings);
+        if(settings.maxHeads != int(tracker.size())){
+            tracker.setMaxHeads(settings.maxHeads);
+        }
+    }
+
+    const Settings & getSettings() const {
+        return settings;
+    }
+
+    // forget the learned background
+    void resetBackground(){
+        view.resetBackground();
+    }
+
+    // one depth image, time in seconds on any clock that only increases
+    void process(const uint16_t * depth, const rs2_intrinsics & intrinsics, float depthScale, unsigned long long frameNumber, double timestamp, float time){
+        const auto & filtered = preFilter.process(depth, intrinsics.width, intrinsics, frameNumber, timestamp);
+        pyramid.build(filtered.data.data(), filtered.intrinsics, coarseLevel);
+
+        ViewFrame frame;
+        frame.depth = &filtered.data;
+        frame.intrinsics = filtered.intrinsics;
+        frame.pyramid = &pyramid;
+        frame.depthScale = depthScale;
+
+        fusion.begin(tracker, settings);
+        fusion.prepare(view, frame, cameraToBox, halfSize);
+        fusion.detect(tracker, cameraToBox, cameraGlobal, halfSize);
+        fusion.gather(tracker, view, frame);
+        fusion.classify(tracker);
+        tracker.update(time);
+    }
+
+    const HeadTracker & getTracker() const {
+        return tracker;
+    }
+
+    HeadTracker & getTracker(){
+        return tracker;
+    }
+
+    // detected head positions of the last frame, global
+    const std::vector<glm::vec3> & getCandidates() const {
+        return fusion.getCandidates();
+    }
+
+private:
+
+    void applySettings(const Settings & settings){
+        this->settings = settings;
+        cameraGlobal = poseMatrix(settings.cameraPosition, settings.cameraRotation);
+        cameraToBox = glm::inverse(poseMatrix(settings.boxPosition, settings.boxRotation)) * cameraGlobal;
+        halfSize = settings.boxSize / 2.0f;
+
+        tracker.setCamera(cameraGlobal);
+        tracker.setStartingPoint(settings.startPosition);
+        tracker.setSmoothing(settings.oneEuroSmoothing, settings.oneEuro);
+    }
+
+    Settings settings;
+    glm::mat4 cameraGlobal;
+    glm::mat4 cameraToBox;
+    glm::vec3 halfSize;
+
+    DepthPreFilter preFilter;
+    DepthPyramid pyramid;
+    View view;
+    Fusion fusion;
+    HeadTracker tracker;
+};
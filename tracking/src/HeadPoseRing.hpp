@@ -0,0 +1,249 @@
+//
+//  HeadPoseRing.hpp
+//  tracking
+//
+
+#pragma once
+
+#include "HeadTracker.hpp"
+#include "HeadPipeline.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Head poses handed from a tracking process to the projection app through
+// POSIX shared memory.
+//
+// The tracker publishes one frame per depth image into a ring of slots, each
+// guarded by a sequence number that is odd while the slot is written. Readers
+// look at the newest slot in place and check the sequence afterwards, so
+// neither side ever waits for the other and a tracker that hangs or restarts
+// just stops the frames from coming. The other way round, the app writes the
+// pipeline settings into a control block the tracker picks up.
+//
+// The segment outlives both processes, a restarted tracker carries on in it
+// and the app keeps its mapping.
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "shared memory needs lock free atomics");
+
+// steady clock seconds, the time base shared by both processes
+inline double headPoseClock(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct HeadPose {
+    int32_t id;
+    int32_t trackId;
+    HeadTrack::TRACKING_STATE state;
+    float radius;
+    float firstTimeTracking; // on the tracker clock, see HeadPoseFrame::trackerTime
+    float lastTimeTracking;
+    float lastTrackPointWeighedCount;
+    glm::vec3 globalPosition;
+    glm::vec3 rawGlobalPosition;
+    glm::vec3 globalFloorPoint;
+};
+
+struct HeadPoseFrame {
+    uint64_t frameNumber;
+    double deviceTimestamp; // ms, on the camera clock
+    double arrivalTime; // headPoseClock() when the depth image arrived
+    double publishTime; // and when the heads were published
+    float trackerTime; // the time the tracker was updated with
+    int32_t lastTrackId; // so a restarted tracker does not hand out trackIds again
+    int32_t headCount; // in tracker order, the first one first
+    HeadPose heads[HeadKernel::maxHeads];
+};
+
+static const char headPoseMagic[8] = {'O','R','H','E','A','D','S','\0'};
+static const uint32_t headPoseVersion = 1;
+
+static_assert(std::is_trivially_copyable<HeadPoseFrame>::value, "frames are copied as bytes");
+static_assert(std::is_trivially_copyable<HeadPipeline::Settings>::value, "settings are copied as bytes");
+
+class HeadPoseRing {
+public:
+
+    static const uint32_t capacity = 16; // frames, half a second at 30 fps
+
+    ~HeadPoseRing(){
+        close();
+    }
+
+    // TRACKER
+
+    // creates the segment, or carries on in one a previous tracker left behind
+    bool create(const std::string & name){
+        close();
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+        if(fd < 0) return false;
+        struct stat st;
+        fstat(fd, &st);
+        // some systems round the size up to whole pages
+        const bool fresh = size_t(st.st_size) < sizeof(Layout);
+        if(fresh && ftruncate(fd, sizeof(Layout)) != 0){
+            ::close(fd);
+            return false;
+        }
+        if(!map(fd)) return false;
+        if(fresh || memcmp(layout->magic, headPoseMagic, sizeof(headPoseMagic)) != 0 || layout->version != headPoseVersion){
+            // zeroed by ftruncate or from something else, the magic goes in last
+            memset((void*)layout, 0, sizeof(Layout));
+            layout->version = headPoseVersion;
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(layout->magic, headPoseMagic, sizeof(headPoseMagic));
+        } else {
+            // a tracker or app that died while writing left a sequence odd, with the
+            // parity flipped every later frame would look torn and torn ones whole
+            for(auto & slot : layout->slots){
+                roundUpToEven(slot.sequence);
+            }
+            roundUpToEven(layout->control.sequence);
+        }
+        layout->writerPid.store(getpid(), std::memory_order_relaxed);
+        return true;
+    }
+
+    void publish(const HeadPoseFrame & frame){
+        const uint64_t written = layout->written.load(std::memory_order_relaxed);
+        Slot & slot = layout->slots[written % capacity];
+        const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy((void*)&slot.frame, &frame, sizeof(frame));
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+        layout->written.store(written + 1, std::memory_order_release);
+    }
+
+    // copies the settings if the app changed them since the last call
+    bool readSettings(HeadPipeline::Settings & settings){
+        const uint32_t changes = layout->control.sequence.load(std::memory_order_acquire);
+        if(changes == seenSettings || changes == 0) return false;
+        if(!readSequenced(layout->control.sequence, [&]{ memcpy((void*)&settings, (const void*)&layout->control.settings, sizeof(settings)); })) return false;
+        seenSettings = changes;
+        return true;
+    }
+
+    // APP
+
+    // attaches to a segment a tracker created, false until there is one
+    bool open(const std::string & name){
+        close();
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if(fd < 0) return false;
+        struct stat st;
+        fstat(fd, &st);
+        if(size_t(st.st_size) < sizeof(Layout)){
+            ::close(fd);
+            return false;
+        }
+        if(!map(fd)) return false;
+        if(memcmp(layout->magic, headPoseMagic, sizeof(headPoseMagic)) != 0 || layout->version != headPoseVersion){
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    // frames published so far, a new one is there when this changes
+    uint64_t getWritten() const {
+        return layout->written.load(std::memory_order_acquire);
+    }
+
+    // calls f with the newest frame right where it is in the segment; f only
+    // reads, and may be called again when the tracker overwrote the frame
+    // meanwhile, returns false when there is none yet or it kept changing
+    template<class F>
+    bool readLatest(F f) const {
+        for(int attempt = 0; attempt < 4; attempt++){
+            const uint64_t written = getWritten();
+            if(written == 0) return false;
+            const Slot & slot = layout->slots[(written - 1) % capacity];
+            if(readSequenced(slot.sequence, [&]{ f(slot.frame); })) return true;
+        }
+        return false;
+    }
+
+    void writeSettings(const HeadPipeline::Settings & settings){
+        auto & control = layout->control;
+        const uint32_t sequence = control.sequence.load(std::memory_order_relaxed);
+        control.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy((void*)&control.settings, &settings, sizeof(settings));
+        control.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // the tracker process that last created the segment
+    int getWriterPid() const {
+        return layout->writerPid.load(std::memory_order_relaxed);
+    }
+
+    // BOTH
+
+    bool isOpen() const {
+        return layout != nullptr;
+    }
+
+    void close(){
+        if(layout != nullptr){
+            munmap((void*)layout, sizeof(Layout));
+            layout = nullptr;
+        }
+    }
+
+private:
+
+    struct Slot {
+        std::atomic<uint32_t> sequence; // odd while written
+        HeadPoseFrame frame;
+    };
+
+    struct Control {
+        std::atomic<uint32_t> sequence; // odd while written, 0 before the app wrote anything
+        HeadPipeline::Settings settings;
+    };
+
+    struct Layout {
+        char magic[8];
+        uint32_t version;
+        std::atomic<int32_t> writerPid;
+        std::atomic<uint64_t> written;
+        Control control;
+        Slot slots[capacity];
+    };
+
+    bool map(int fd){
+        void * mapping = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(mapping == MAP_FAILED) return false;
+        layout = (Layout*)mapping;
+        return true;
+    }
+
+    // the slot a crash left half written is the next one published, readers
+    // never get to it before it is written again
+    static void roundUpToEven(std::atomic<uint32_t> & sequence){
+        uint32_t value = sequence.load(std::memory_order_relaxed);
+        while((value & 1) && !sequence.compare_exchange_weak(value, value + 1, std::memory_order_release, std::memory_order_relaxed)){}
+    }
+
+    // runs read between two looks at the sequence, true if nothing was written meanwhile
+    template<class F>
+    static bool readSequenced(const std::atomic<uint32_t> & sequence, F read){
+        const uint32_t before = sequence.load(std::memory_order_acquire);
+        if(before & 1) return false;
+        read();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return sequence.load(std::memory_order_relaxed) == before;
+    }
+
+    Layout * layout = nullptr;
+    uint32_t seenSettings = 0;
+};
@@ -0,0 +1 @@
+#include "HeadTracker.hpp"
@@ -0,0 +1,683 @@
+//
+//  HeadTracker.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "HeadKernel.hpp"
+#include "VoxelHash.hpp"
+#include "WorkerPool.hpp"
+#include "HungarianSolver.hpp"
+#include "KalmanBank.hpp"
+#include "OneEuroFilter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Tracking state of one head. Plain data, positions are in tracking camera
+// space, the filters live in the HeadTracker.
+
+struct HeadTrack {
+    enum class TRACKING_STATE {
+        READY,
+        TRACKING,
+        LOST
+    };
+    
+    TRACKING_STATE state = TRACKING_STATE::READY;
+    int id = 0;
+    int trackId = 0; // new for every person, kept while tracking or lost, 0 when ready
+    float lastTimeTracking = 0;
+    float firstTimeTracking = 0;
+    
+    glm::vec3 position;
+    glm::vec3 rawGlobalPosition;
+    glm::vec3 localFloorPoint;
+    float radius = 0.0;
+    float radiusSquared = 0.0;
+    float radiusSquaredScale = 1.0;
+    float radiusSquaredMax = 0.0;
+    
+    glm::vec3 trackPointSum;
+    int trackPointCount = 1;
+    int lastTrackPointCount = 1;
+    float trackPointWeighedCount = 1.0;
+    float lastTrackPointWeighedCount = 1.0;
+
+    bool isReady() const {
+        return state == TRACKING_STATE::READY;
+    }
+    
+    bool isTracking() const {
+        return state == TRACKING_STATE::TRACKING;
+    }
+    
+    bool isLost() const {
+        return state == TRACKING_STATE::LOST;
+    }
+    
+    bool isTrackingOrLost() const {
+        return isTracking() || isLost();
+    }
+    
+    void setRadius(float radius){
+        this->radius = radius;
+        radiusSquared = radius*radius;
+    }
+};
+
+// The head tracking itself, without a window or a scene graph: heads are
+// found among the points of a depth camera, followed from frame to frame and
+// filtered. Positions are in tracking camera space, the camera's pose and the
+// starting point of new heads are set from outside.
+//
+// Used by the bridge app through MeshTracker and on its own by headtrack-batch.
+
+class HeadTracker {
+public:
+
+    // what happened to a head during an update
+    struct Event {
+        enum Type {
+            NEW, // a ready head started tracking someone
+            FOUND, // a lost head found its person again
+            LOST,
+            END // a lost head gave up and is ready again
+        };
+        Type type;
+        int id = 0;
+        int trackId = 0;
+        float duration = 0; // END only, seconds since NEW
+    };
+
+    float headRadius = 0.3/2.;
+    float ttl = 4.0;
+    glm::vec3 globalDirectionBias = {0,0.0375,0.0};
+    float radiusSquaredScaleTracking = 2.0;
+    float radiusSquaredScaleReady = 3.0;
+    float minFloorDistance = 0.5;
+
+    // head slots, they never move so indices stay valid
+    std::vector<HeadTrack> heads;
+    // slots with the first ones first, active heads before ready ones
+    std::vector<int> order;
+
+    int maxHeads = 5;
+    int requestedMaxHeads = 0; // as passed to setMaxHeads, before it is capped
+
+    void setup(int maxHeads){
+
+        // room for every head there can be, so slots never reallocate
+        heads.reserve(HeadKernel::maxHeads);
+        order.reserve(HeadKernel::maxHeads);
+        measurements.reserve(HeadKernel::maxHeads);
+        smoothers.reserve(HeadKernel::maxHeads);
+        kalman.setup(0, 1/10000000000., 1/10000000.); // inverse of (smoothness, rapidness);
+
+        setMaxHeads(maxHeads);
+    }
+
+    // global transform of the tracking camera
+    void setCamera(const glm::mat4 & cameraGlobal){
+        this->cameraGlobal = cameraGlobal;
+    }
+
+    const glm::mat4 & getCamera() const {
+        return cameraGlobal;
+    }
+
+    // where ready heads wait, global
+    void setStartingPoint(const glm::vec3 & startingPoint){
+        this->startingPoint = startingPoint;
+    }
+
+    const glm::vec3 & getStartingPoint() const {
+        return startingPoint;
+    }
+
+    // threads addVertices may use besides the calling one, -1 for one per core;
+    // 0 keeps it on the calling thread, for when trackers run side by side
+    void setThreads(int numThreads){
+        threads = numThreads;
+    }
+
+    // adds or removes heads, new heads start out ready at the starting point;
+    // the kernel takes at most HeadKernel::maxHeads, more are capped with a warning
+    void setMaxHeads(int maxHeads){
+        if(maxHeads == requestedMaxHeads) return;
+        requestedMaxHeads = maxHeads;
+        if(maxHeads > int(HeadKernel::maxHeads)){
+            std::cerr << "HeadTracker: " << maxHeads << " heads asked for, tracking at most " << HeadKernel::maxHeads << std::endl;
+        }
+        maxHeads = std::min(std::max(maxHeads, 1), int(HeadKernel::maxHeads));
+        int oldSize = heads.size();
+        this->maxHeads = maxHeads;
+        
+        // keep the strongest heads, tracking ones before the rest
+        if(maxHeads < oldSize){
+            std::vector<int> strongest(order);
+            std::stable_sort(strongest.begin(), strongest.end(), [this](int a, int b){
+                if(heads[a].isTracking() != heads[b].isTracking()) return heads[a].isTracking();
+                return heads[a].lastTrackPointWeighedCount > heads[b].lastTrackPointWeighedCount;
+            });
+            int droppedTracking = 0;
+            for(int i = maxHeads; i < oldSize; i++){
+                if(heads[strongest[i]].isTracking()) droppedTracking++;
+            }
+            if(droppedTracking > 0){
+                std::cerr << "HeadTracker: down to " << maxHeads << " heads, dropping " << droppedTracking << " that are tracking" << std::endl;
+            }
+            std::vector<HeadTrack> keptHeads;
+            std::vector<KalmanBank<2>::Track> keptKalmans;
+            std::vector<OneEuroFilter> keptSmoothers;
+            keptHeads.reserve(HeadKernel::maxHeads);
+            keptSmoothers.reserve(HeadKernel::maxHeads);
+            for(int i = 0; i < maxHeads; i++){
+                keptHeads.push_back(heads[strongest[i]]);
+                keptKalmans.push_back(kalman.getTrack(strongest[i]));
+                keptSmoothers.push_back(smoothers[strongest[i]]);
+            }
+            heads.swap(keptHeads);
+            smoothers.swap(keptSmoothers);
+            for(int i = 0; i < maxHeads; i++){
+                kalman.setTrack(i, keptKalmans[i]);
+            }
+        }
+        heads.resize(maxHeads);
+        kalman.resize(maxHeads);
+        measurements.resize(maxHeads);
+        smoothers.resize(maxHeads);
+        
+        int id = 0;
+        for( auto & head : heads){
+            id = std::max(id, head.id);
+        }
+        for(int i = oldSize; i < maxHeads; i++){
+            auto & head = heads[i];
+            head = HeadTrack();
+            head.setRadius(headRadius);
+            head.radiusSquaredScale = 1.0;
+            head.id = ++id;
+            kalman.reset(i);
+            smoothers[i].setup(oneEuroSettings);
+            smoothers[i].reset();
+            head.position = toLocal(startingPoint, cameraGlobal);
+        }
+        
+        order.resize(maxHeads);
+        for(int i = 0; i < maxHeads; i++){
+            order[i] = i;
+        }
+        sortOrder();
+    }
+    
+    // heads in order, front() is the one that has been tracking the longest
+    size_t size() const {
+        return order.size();
+    }
+    
+    const HeadTrack & getHead(size_t i) const {
+        return heads[order[i]];
+    }
+    
+    glm::vec3 getGlobalPosition(const HeadTrack & head) const {
+        return getGlobalPosition(head, cameraGlobal);
+    }
+    
+    // floor point below the head, the way MeshTracker draws it
+    glm::vec3 getGlobalFloorPoint(const HeadTrack & head) const {
+        auto floorP = cameraGlobal * glm::vec4(head.localFloorPoint, 1.0);
+        return glm::vec3(floorP) / floorP.w;
+    }
+    
+    // depth is where the sensor that saw v measured it, and weighs the point
+    float addTrackPoint(HeadTrack & head, glm::vec3 & v, float depth){
+        float dist = distance2(head.position, v);
+        float radiusSquaredScaled= head.radiusSquared * head.radiusSquaredScale;
+        if(dist < radiusSquaredScaled){
+            head.trackPointSum += v;
+            head.trackPointCount++;
+            head.trackPointWeighedCount += depth*depth;
+            head.radiusSquaredMax = fmaxf(head.radiusSquaredMax, dist);
+            return 1;
+        } else if (dist < head.radiusSquared * 1.5){
+            return 2;
+        } else /*if (dist < 3.0*3.0)*/ {
+            // distance to line towards floor
+            
+            float distV2Line = -1.0;
+            
+            auto & pos = head.position;
+            auto & localFloorPoint = head.localFloorPoint;
+            float line_dist = distance2(localFloorPoint, pos);
+            if (line_dist == 0) distV2Line = distance2(v, localFloorPoint);
+            else {
+            float t = ((v.x - localFloorPoint.x) * (pos.x - localFloorPoint.x) + (v.y - localFloorPoint.y) * (pos.y - localFloorPoint.y) + (v.z - localFloorPoint.z) * (pos.z - localFloorPoint.z)) / line_dist;
+            t = std::min(std::max(t, 0.0f), 1.0f);
+            distV2Line = distance2(v, glm::vec3(localFloorPoint.x + t * (pos.x - localFloorPoint.x),
+                                                     localFloorPoint.y + t * (pos.y - localFloorPoint.y),
+                                                     localFloorPoint.z + t * (pos.z - localFloorPoint.z)));
+            }
+            if(distV2Line < minFloorDistance*minFloorDistance)
+                return 3;
+        }
+        return 0;
+    }
+    
+    int addVertex(glm::vec3 & v){
+        return addVertex(v, v.z);
+    }
+
+    int addVertex(glm::vec3 & v, float depth){
+        int pointFound = 0;
+        
+        // tracking heads consume first
+        for(auto i : order){
+            if(heads[i].isTracking()){
+                pointFound = addTrackPoint(heads[i], v, depth);
+            }
+            if(pointFound > 0) break;
+        }
+        if(pointFound > 0) return pointFound;
+        
+        // then comes the rest
+        for(auto i : order){
+            if(!heads[i].isTracking()){
+                pointFound = addTrackPoint(heads[i], v, depth);
+            }
+            if(pointFound > 0) break;
+        }
+        return pointFound;
+    }
+
+    // matches detected head positions to the heads in one global assignment,
+    // within a gate around each tracking or lost head; candidates nobody gets
+    // are handed to ready heads
+    void associate(const std::vector<glm::vec3> & candidates){
+        
+        
+        activeHeads.clear();
+        for(auto i : order){
+            if(heads[i].isTrackingOrLost()) activeHeads.push_back(i);
+        }
+        
+        const float gate = headRadius * 3.0;
+        const float lostGate = headRadius * 6.0;
+        const int rows = activeHeads.size();
+        const int cols = candidates.size();
+        associationCost.assign(rows * cols, lostGate);
+        for(int r = 0; r < rows; r++){
+            auto & head = heads[activeHeads[r]];
+            auto p = getGlobalPosition(head, cameraGlobal);
+            float headGate = head.isLost() ? lostGate : gate;
+            for(int c = 0; c < cols; c++){
+                float d = glm::distance(p, candidates[c]);
+                // everything outside the head's own gate costs as much as the widest gate, which means no match
+                associationCost[r * cols + c] = d < headGate ? d : lostGate;
+            }
+        }
+        auto & assignment = assignmentSolver.solve(associationCost, rows, cols, lostGate);
+        
+        candidateTaken.assign(cols, false);
+        for(int r = 0; r < rows; r++){
+            if(assignment[r] < 0) continue;
+            candidateTaken[assignment[r]] = true;
+            // lost heads jump to where they are found, tracking heads follow their own points
+            auto & head = heads[activeHeads[r]];
+            if(head.isLost()) placeAt(head, candidates[assignment[r]], cameraGlobal);
+        }
+        
+        // a candidate right next to an active head is that head, even if it matched another one
+        size_t next = 0;
+        for(int c = 0; c < cols; c++){
+            if(candidateTaken[c]) continue;
+            bool claimed = false;
+            for(auto i : activeHeads){
+                if(glm::distance(getGlobalPosition(heads[i], cameraGlobal), candidates[c]) < headRadius * 2.0){
+                    claimed = true;
+                    break;
+                }
+            }
+            if(claimed) continue;
+            while(next < order.size() && !heads[order[next]].isReady()) next++;
+            if(next == order.size()) break;
+            placeAt(heads[order[next++]], candidates[c], cameraGlobal);
+        }
+    }
+    
+    // classifies a whole frame of points at once, labels as returned by addVertex,
+    // without depth the points are taken to be in the space of the sensor that saw them
+    void addVertices(const float * x, const float * y, const float * z, uint8_t * labels, size_t n, const float * depth = nullptr){
+        
+        // tracking heads consume first, then comes the rest
+        kernelOrder.clear();
+        for(auto i : order){
+            if(heads[i].isTracking()) kernelOrder.push_back(i);
+        }
+        for(auto i : order){
+            if(!heads[i].isTracking()) kernelOrder.push_back(i);
+        }
+        if(kernelOrder.size() > HeadKernel::maxHeads) kernelOrder.resize(HeadKernel::maxHeads);
+        
+        if(voxels.getCellSize() != headRadius) voxels.setup(headRadius);
+        voxels.clear();
+        
+        kernel.heads.resize(kernelOrder.size());
+        for(size_t i = 0; i < kernelOrder.size(); i++){
+            auto & head = heads[kernelOrder[i]];
+            auto & k = kernel.heads[i];
+            auto pos = head.position;
+            k = HeadKernelHead();
+            k.x = pos.x;
+            k.y = pos.y;
+            k.z = pos.z;
+            k.radiusSquaredScaled = head.radiusSquared * head.radiusSquaredScale;
+            k.radiusSquaredOuter = head.radiusSquared * 1.5;
+            k.floorX = head.localFloorPoint.x;
+            k.floorY = head.localFloorPoint.y;
+            k.floorZ = head.localFloorPoint.z;
+            k.minFloorDistance = minFloorDistance;
+            
+            // cells the sphere and the floor line capsule can reach, with a little slack
+            uint32_t bit = 1u << i;
+            float r = getReach(head);
+            voxels.mark(pos.x - r, pos.y - r, pos.z - r, pos.x + r, pos.y + r, pos.z + r, bit);
+            auto & f = head.localFloorPoint;
+            float c = minFloorDistance * 1.001 + 0.001;
+            voxels.mark(fminf(pos.x, f.x) - c, fminf(pos.y, f.y) - c, fminf(pos.z, f.z) - c,
+                        fmaxf(pos.x, f.x) + c, fmaxf(pos.y, f.y) + c, fmaxf(pos.z, f.z) + c, bit);
+        }
+        
+        // group the points by the heads that can reach them
+        pointGroup.resize(n);
+        groupMasks.clear();
+        groupMasks.push_back(0);
+        for(size_t i = 0; i < n; i++){
+            uint32_t mask = voxels.lookup(x[i], y[i], z[i]);
+            size_t g = 0;
+            while(g < groupMasks.size() && groupMasks[g] != mask) g++;
+            if(g == groupMasks.size()) groupMasks.push_back(mask);
+            pointGroup[i] = g;
+        }
+        
+        // counting sort into contiguous runs per group
+        groupStart.assign(groupMasks.size() + 1, 0);
+        for(size_t i = 0; i < n; i++){
+            groupStart[pointGroup[i] + 1]++;
+        }
+        for(size_t g = 0; g < groupMasks.size(); g++){
+            groupStart[g + 1] += groupStart[g];
+        }
+        sortedX.resize(n);
+        sortedY.resize(n);
+        sortedZ.resize(n);
+        sortedDepth.resize(n);
+        sortedIndex.resize(n);
+        sortedLabels.resize(n);
+        groupFill.assign(groupStart.begin(), groupStart.end() - 1);
+        for(size_t i = 0; i < n; i++){
+            size_t s = groupFill[pointGroup[i]]++;
+            sortedX[s] = x[i];
+            sortedY[s] = y[i];
+            sortedZ[s] = z[i];
+            sortedDepth[s] = depth ? depth[i] : z[i];
+            sortedIndex[s] = i;
+        }
+        
+        // split the runs into fixed chunks so the partial sums, and with them
+        // the rounding, do not depend on how the chunks land on the workers
+        chunks.clear();
+        for(size_t g = 1; g < groupMasks.size(); g++){
+            for(size_t s = groupStart[g]; s < groupStart[g + 1]; s += chunkSize){
+                chunks.push_back({s, std::min(chunkSize, groupStart[g + 1] - s), groupMasks[g]});
+            }
+        }
+        
+        // points no head can reach are left unlabelled
+        kernel.begin();
+        if(chunkSums.size() < chunks.size()) chunkSums.resize(chunks.size());
+        if(threads != 0 && workers.getNumThreads() == 0 && std::thread::hardware_concurrency() > 1) workers.setup(threads);
+        workers.parallelFor(chunks.size(), [this](size_t c){
+            auto & chunk = chunks[c];
+            kernel.clear(chunkSums[c]);
+            kernel.classify(&sortedX[chunk.start], &sortedY[chunk.start], &sortedZ[chunk.start], &sortedDepth[chunk.start], &sortedLabels[chunk.start], chunk.count, chunk.headMask, chunkSums[c]);
+        });
+        for(size_t c = 0; c < chunks.size(); c++){
+            kernel.add(chunkSums[c]);
+        }
+        
+        for(size_t s = 0; s < groupStart[1]; s++){
+            labels[sortedIndex[s]] = 0;
+        }
+        for(size_t s = groupStart[1]; s < n; s++){
+            labels[sortedIndex[s]] = sortedLabels[s];
+        }
+        
+        for(size_t i = 0; i < kernelOrder.size(); i++){
+            auto & head = heads[kernelOrder[i]];
+            auto & k = kernel.heads[i];
+            head.trackPointSum += glm::vec3(k.sumX, k.sumY, k.sumZ);
+            head.trackPointCount += k.count;
+            head.trackPointWeighedCount += k.weighedCount;
+            head.radiusSquaredMax = fmaxf(head.radiusSquaredMax, k.radiusSquaredMax);
+        }
+    }
+
+    // filters the heads with one euro filters instead of Kalman filters,
+    // both run all the time so switching does not jump
+    void setSmoothing(bool oneEuro, const OneEuroFilter::Settings & settings){
+        oneEuroSmoothing = oneEuro;
+        oneEuroSettings = settings;
+        for(auto & smoother : smoothers){
+            smoother.setup(settings);
+        }
+    }
+
+    // radius around a head, camera space, outside of which points cannot add to any head
+    float getReach(const HeadTrack & head) const {
+        return sqrtf(fmaxf(head.radiusSquared * head.radiusSquaredScale, head.radiusSquared * 1.5)) * 1.001 + 0.001;
+    }
+
+    // now in seconds, the same clock for every update
+    void update(float now){
+        events.clear();
+        // all filters step together, so measure every head first
+        for(size_t i = 0; i < heads.size(); i++){
+            measurements[i] = measureHead(heads[i], now, cameraGlobal);
+        }
+        kalman.update(measurements.data());
+        for(size_t i = 0; i < heads.size(); i++){
+            const glm::vec3 smoothed = smoothers[i].filter(measurements[i], now);
+            updateHead(heads[i], oneEuroSmoothing ? smoothed : kalman.getEstimation(i), now, cameraGlobal);
+        }
+        sortOrder();
+    }
+
+    // what happened during the last update
+    const std::vector<Event> & getEvents() const {
+        return events;
+    }
+
+    // the trackId the last person got, so a restarted tracker can carry on counting
+    int getLastTrackId() const {
+        return lastTrackId;
+    }
+
+    void setLastTrackId(int trackId){
+        lastTrackId = trackId;
+    }
+
+private:
+
+    static float distance2(const glm::vec3 & a, const glm::vec3 & b){
+        const glm::vec3 d = a - b;
+        return glm::dot(d, d);
+    }
+
+    void addEvent(Event::Type type, const HeadTrack & head, float duration = 0){
+        Event event;
+        event.type = type;
+        event.id = head.id;
+        event.trackId = head.trackId;
+        event.duration = duration;
+        events.push_back(event);
+    }
+    
+    // head transforms, the same math ofNode did when heads were children of the camera
+    
+    static glm::mat4 headMatrix(const glm::vec3 & position, const glm::mat4 & cameraGlobal){
+        return cameraGlobal * glm::translate(glm::mat4(1.0), position);
+    }
+    
+    static glm::vec3 getGlobalPosition(const HeadTrack & head, const glm::mat4 & cameraGlobal){
+        return glm::vec3(headMatrix(head.position, cameraGlobal)[3]);
+    }
+    
+    static glm::vec3 toLocal(const glm::vec3 & globalPosition, const glm::mat4 & cameraGlobal){
+        auto newP = glm::inverse(cameraGlobal) * glm::vec4(globalPosition, 1.0);
+        return glm::vec3(newP) / newP.w;
+    }
+    
+    static void updateFloorPoint(HeadTrack & head, const glm::vec3 & gp, const glm::mat4 & cameraGlobal){
+        auto newFloorP = glm::inverse(headMatrix(head.position, cameraGlobal)) * glm::vec4(gp.x, 0.0, gp.z, 1.0);
+        head.localFloorPoint = glm::vec3(newFloorP) / newFloorP.w;
+    }
+    
+    // move a ready head onto a detected candidate so it can pick up its points
+    void placeAt(HeadTrack & head, const glm::vec3 & globalPosition, const glm::mat4 & cameraGlobal){
+        head.position = toLocal(globalPosition, cameraGlobal);
+        updateFloorPoint(head, globalPosition, cameraGlobal);
+        head.trackPointSum = head.position;
+    }
+    
+    bool hasEnoughPoints(const HeadTrack & head) const {
+        return head.trackPointWeighedCount > 800.0;
+    }
+    
+    // first half of a head's update, returns what to feed its filter
+    glm::vec3 measureHead(HeadTrack & head, float now, const glm::mat4 & cameraGlobal){
+        
+        if(hasEnoughPoints(head)){
+            if(head.isReady() || head.isLost()){
+                if(head.isReady()) head.firstTimeTracking = now;
+                if(head.isReady()) head.trackId = ++lastTrackId;
+                addEvent(head.isReady() ? Event::NEW : Event::FOUND, head);
+                head.state = HeadTrack::TRACKING_STATE::TRACKING;
+            }
+            head.radiusSquaredScale = radiusSquaredScaleTracking;
+            head.trackPointSum /= head.trackPointCount;
+            head.lastTrackPointCount = head.trackPointCount;
+            head.lastTrackPointWeighedCount = head.trackPointWeighedCount;
+            head.position = head.trackPointSum;
+            head.rawGlobalPosition = getGlobalPosition(head, cameraGlobal);
+            return head.rawGlobalPosition+globalDirectionBias;
+        }
+        return getGlobalPosition(head, cameraGlobal);
+    }
+    
+    // second half, with the filtered position
+    void updateHead(HeadTrack & head, const glm::vec3 & gp, float now, const glm::mat4 & cameraGlobal){
+        
+        if(hasEnoughPoints(head)){
+            head.position = toLocal(gp, cameraGlobal);
+            updateFloorPoint(head, gp, cameraGlobal);
+            head.radiusSquaredMax = 0.0;
+            head.lastTimeTracking = now;
+        } else {
+            if(head.isTracking()) head.radiusSquaredScale = radiusSquaredScaleTracking * 2.0;
+        }
+        if(now - head.lastTimeTracking > ttl){
+            if(head.isTracking()){
+                head.state = HeadTrack::TRACKING_STATE::LOST;
+                head.lastTimeTracking = now;
+                addEvent(Event::LOST, head);
+            } else if (head.isLost()) {
+                head.position = toLocal(startingPoint, cameraGlobal);
+                head.state = HeadTrack::TRACKING_STATE::READY;
+                head.radiusSquaredScale = radiusSquaredScaleReady;
+                head.setRadius(headRadius);
+                updateFloorPoint(head, getGlobalPosition(head, cameraGlobal), cameraGlobal);
+                head.lastTimeTracking = now;
+                addEvent(Event::END, head, now - head.firstTimeTracking);
+                head.firstTimeTracking = 0;
+                head.trackId = 0;
+            } else if(head.isReady()){
+                head.position = toLocal(startingPoint, cameraGlobal);
+                head.firstTimeTracking = 0;
+            }
+        }
+        
+        head.trackPointSum = head.position;
+        head.trackPointCount = 1;
+        head.trackPointWeighedCount = 1.0;
+    }
+    
+    // make sure the first ones are the first, active heads before ready ones,
+    // then by when they started tracking and by id; an insertion sort on the
+    // indices, stable and without allocating
+    void sortOrder(){
+        auto before = [this](int a, int b){
+            auto & ha = heads[a];
+            auto & hb = heads[b];
+            bool aActive = !ha.isReady();
+            bool bActive = !hb.isReady();
+            if(aActive != bActive) return aActive;
+            if(ha.firstTimeTracking != hb.firstTimeTracking) return ha.firstTimeTracking < hb.firstTimeTracking;
+            return ha.id < hb.id;
+        };
+        for(size_t i = 1; i < order.size(); i++){
+            int slot = order[i];
+            size_t j = i;
+            while(j > 0 && before(slot, order[j - 1])){
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = slot;
+        }
+    }
+    
+    KalmanBank<2> kalman; // one track per slot
+    std::vector<glm::vec3> measurements;
+    std::vector<OneEuroFilter> smoothers; // one per slot as well
+    bool oneEuroSmoothing = false;
+    OneEuroFilter::Settings oneEuroSettings;
+    int lastTrackId = 0;
+    std::vector<Event> events;
+
+    glm::mat4 cameraGlobal = glm::mat4(1.0);
+    glm::vec3 startingPoint;
+    
+    HeadKernel kernel;
+    std::vector<int> kernelOrder;
+    
+    std::vector<int> activeHeads;
+    std::vector<float> associationCost;
+    std::vector<bool> candidateTaken;
+    HungarianSolver assignmentSolver;
+    
+    VoxelHash voxels;
+    std::vector<uint32_t> groupMasks;
+    std::vector<uint32_t> pointGroup;
+    std::vector<size_t> groupStart;
+    std::vector<size_t> groupFill;
+    std::vector<float> sortedX, sortedY, sortedZ, sortedDepth;
+    std::vector<uint32_t> sortedIndex;
+    std::vector<uint8_t> sortedLabels;
+    
+    struct Chunk {
+        size_t start;
+        size_t count;
+        uint32_t headMask;
+    };
+    const size_t chunkSize = 4096;
+    std::vector<Chunk> chunks;
+    std::vector<HeadKernel::Sums> chunkSums;
+    WorkerPool workers;
+    int threads = -1;
+};
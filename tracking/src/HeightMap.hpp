@@ -0,0 +1,165 @@
+//
+//  HeightMap.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Top down height map over the floor of the tracking box, for finding people
+// wherever they enter.
+//
+// Every point raises the cell below it to its height above the floor, keeping
+// the highest point per cell. Cells above the minimum head height are grouped
+// into 8-connected blobs, and the local maxima of each blob, thinned out to
+// one per minimum separation, become head candidates at the top of the blob
+// minus a head radius.
+
+class HeightMap {
+public:
+
+    struct Settings {
+        float cellSize = 0.05;
+        float minHeight = 1.0; // m above the floor, world y = 0
+        int minCells = 6; // smaller blobs are noise
+        float minSeparation = 0.35; // m between candidates
+    };
+
+    struct Candidate {
+        glm::vec3 top; // world position of the highest point
+        int cells = 0; // size of the blob it was found in
+    };
+
+    void setup(const Settings & settings){
+        this->settings = settings;
+    }
+
+    // bins camera space points into the grid over the tracking box floor
+    void fill(const float * x, const float * y, const float * z, size_t n,
+              const glm::mat4 & cameraToTracker, const glm::mat4 & cameraToWorld, const glm::vec3 & halfSize){
+
+        const float inverseCell = 1.0 / settings.cellSize;
+        width = std::max(1, int(ceilf(2 * halfSize.x * inverseCell)));
+        depth = std::max(1, int(ceilf(2 * halfSize.z * inverseCell)));
+        heights.assign(width * depth, -std::numeric_limits<float>::max());
+        tops.resize(width * depth);
+
+        for(size_t i = 0; i < n; i++){
+            const glm::vec4 p(x[i], y[i], z[i], 1.0);
+            const glm::vec4 t = cameraToTracker * p;
+            int cx = int((t.x + halfSize.x) * inverseCell);
+            int cz = int((t.z + halfSize.z) * inverseCell);
+            if(cx < 0 || cz < 0 || cx >= width || cz >= depth) continue;
+            const glm::vec4 w = cameraToWorld * p;
+            const int cell = cz * width + cx;
+            if(w.y > heights[cell]){
+                heights[cell] = w.y;
+                tops[cell] = glm::vec3(w);
+            }
+        }
+    }
+
+    // blobs and their local maxima, in O(cells)
+    const std::vector<Candidate> & detect(){
+        candidates.clear();
+        blob.assign(width * depth, 0);
+        int blobCount = 0;
+
+        for(int start = 0; start < width * depth; start++){
+            if(blob[start] != 0 || heights[start] < settings.minHeight) continue;
+
+            // flood fill the blob
+            blobCount++;
+            cells.clear();
+            cells.push_back(start);
+            blob[start] = blobCount;
+            for(size_t c = 0; c < cells.size(); c++){
+                const int cx = cells[c] % width;
+                const int cz = cells[c] / width;
+                for(int dz = -1; dz <= 1; dz++){
+                    for(int dx = -1; dx <= 1; dx++){
+                        const int nx = cx + dx, nz = cz + dz;
+                        if(nx < 0 || nz < 0 || nx >= width || nz >= depth) continue;
+                        const int neighbour = nz * width + nx;
+                        if(blob[neighbour] != 0 || heights[neighbour] < settings.minHeight) continue;
+                        blob[neighbour] = blobCount;
+                        cells.push_back(neighbour);
+                    }
+                }
+            }
+            if(int(cells.size()) < settings.minCells) continue;
+
+            // local maxima, highest first
+            maxima.clear();
+            for(int cell : cells){
+                if(isLocalMaximum(cell)) maxima.push_back(cell);
+            }
+            std::sort(maxima.begin(), maxima.end(), [this](int a, int b){
+                return heights[a] > heights[b] || (heights[a] == heights[b] && a < b);
+            });
+
+            const size_t firstCandidate = candidates.size();
+            const float separation2 = settings.minSeparation * settings.minSeparation;
+            for(int cell : maxima){
+                const glm::vec3 & top = tops[cell];
+                bool separate = true;
+                for(size_t c = firstCandidate; c < candidates.size(); c++){
+                    const glm::vec3 d = candidates[c].top - top;
+                    if(d.x * d.x + d.z * d.z < separation2){
+                        separate = false;
+                        break;
+                    }
+                }
+                if(!separate) continue;
+                Candidate candidate;
+                candidate.top = top;
+                candidate.cells = cells.size();
+                candidates.push_back(candidate);
+            }
+        }
+
+        // tallest first, they are the most likely heads
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate & a, const Candidate & b){
+            return a.top.y > b.top.y;
+        });
+        return candidates;
+    }
+
+    const std::vector<Candidate> & getCandidates() const {
+        return candidates;
+    }
+
+private:
+
+    bool isLocalMaximum(int cell) const {
+        const int cx = cell % width;
+        const int cz = cell / width;
+        const float h = heights[cell];
+        for(int dz = -1; dz <= 1; dz++){
+            for(int dx = -1; dx <= 1; dx++){
+                const int nx = cx + dx, nz = cz + dz;
+                if((dx == 0 && dz == 0) || nx < 0 || nz < 0 || nx >= width || nz >= depth) continue;
+                if(heights[nz * width + nx] > h) return false;
+            }
+        }
+        return true;
+    }
+
+    Settings settings;
+
+    int width = 0;
+    int depth = 0;
+    std::vector<float> heights; // world y of the highest point per cell
+    std::vector<glm::vec3> tops;
+    std::vector<int> blob;
+
+    std::vector<int> cells;
+    std::vector<int> maxima;
+    std::vector<Candidate> candidates;
+};
@@ -0,0 +1,94 @@
+//
+//  HungarianSolver.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// Minimum cost assignment of rows to columns, O(n^3) in the larger side.
+//
+// Costs at or above the gate mean the pair may not be matched. The matrix is
+// padded to a square with the gate cost, so a row that can only be matched
+// through a gated or padded cell stays unassigned.
+
+class HungarianSolver {
+public:
+
+    // cost is rows x cols, row major, returns the column for each row or -1
+    const std::vector<int> & solve(const std::vector<float> & cost, int rows, int cols, float gate){
+        assignment.assign(rows, -1);
+        const int n = std::max(rows, cols);
+        if(n == 0) return assignment;
+
+        // square matrix, 1 based as in the classic formulation
+        a.assign((n + 1) * (n + 1), gate);
+        for(int r = 0; r < rows; r++){
+            for(int c = 0; c < cols; c++){
+                a[(r + 1) * (n + 1) + (c + 1)] = std::min(cost[r * cols + c], gate);
+            }
+        }
+
+        const float inf = std::numeric_limits<float>::max();
+        u.assign(n + 1, 0);
+        v.assign(n + 1, 0);
+        p.assign(n + 1, 0);
+        way.assign(n + 1, 0);
+        for(int i = 1; i <= n; i++){
+            p[0] = i;
+            int j0 = 0;
+            minv.assign(n + 1, inf);
+            used.assign(n + 1, false);
+            do {
+                used[j0] = true;
+                const int i0 = p[j0];
+                float delta = inf;
+                int j1 = 0;
+                for(int j = 1; j <= n; j++){
+                    if(used[j]) continue;
+                    const float cur = a[i0 * (n + 1) + j] - u[i0] - v[j];
+                    if(cur < minv[j]){
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if(minv[j] < delta){
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+                for(int j = 0; j <= n; j++){
+                    if(used[j]){
+                        u[p[j]] += delta;
+                        v[j] -= delta;
+                    } else {
+                        minv[j] -= delta;
+                    }
+                }
+                j0 = j1;
+            } while(p[j0] != 0);
+            do {
+                const int j1 = way[j0];
+                p[j0] = p[j1];
+                j0 = j1;
+            } while(j0 != 0);
+        }
+
+        for(int j = 1; j <= n; j++){
+            const int r = p[j] - 1;
+            const int c = j - 1;
+            if(r < rows && c < cols && cost[r * cols + c] < gate){
+                assignment[r] = c;
+            }
+        }
+        return assignment;
+    }
+
+private:
+    std::vector<int> assignment;
+    std::vector<float> a, u, v, minv;
+    std::vector<int> p, way;
+    std::vector<bool> used;
+};
@@ -0,0 +1,187 @@
+//
+//  KalmanBank.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// Kalman filters for the positions of many tracks, without OpenCV.
+//
+// Does the same math as ofxCv::KalmanPosition: a constant velocity model
+// (constant acceleration for N = 3) with one frame time steps, identity
+// process and measurement noise scaled by smoothness and rapidness, and an
+// initial error covariance of 0.1. Because the model treats x, y and z the
+// same way and independently, the full 3N x 3N covariance is three copies of
+// one N x N block, so each track keeps only that block. The state is stored
+// track by track in separate arrays so update runs over all tracks at once.
+
+template<int N>
+class KalmanBank {
+public:
+
+    // state and covariance of one track, to move tracks between slots
+    struct Track {
+        float state[3][N];
+        float covariance[N][N];
+    };
+
+    void setup(size_t count, float smoothness, float rapidness){
+        processNoise = smoothness;
+        measurementNoise = rapidness;
+        resize(count);
+        for(size_t i = 0; i < count; i++){
+            reset(i);
+        }
+    }
+
+    // new tracks start out reset
+    void resize(size_t count){
+        size_t oldCount = size();
+        for(int a = 0; a < 3; a++){
+            for(int k = 0; k < N; k++){
+                state[a][k].resize(count);
+            }
+        }
+        for(int r = 0; r < N; r++){
+            for(int c = 0; c < N; c++){
+                covariance[r][c].resize(count);
+            }
+        }
+        for(size_t i = oldCount; i < count; i++){
+            reset(i);
+        }
+    }
+
+    size_t size() const {
+        return covariance[0][0].size();
+    }
+
+    void reset(size_t i){
+        for(int a = 0; a < 3; a++){
+            for(int k = 0; k < N; k++){
+                state[a][k][i] = 0;
+            }
+        }
+        for(int r = 0; r < N; r++){
+            for(int c = 0; c < N; c++){
+                covariance[r][c][i] = r == c ? 0.1 : 0.0;
+            }
+        }
+    }
+
+    Track getTrack(size_t i) const {
+        Track t;
+        for(int a = 0; a < 3; a++){
+            for(int k = 0; k < N; k++){
+                t.state[a][k] = state[a][k][i];
+            }
+        }
+        for(int r = 0; r < N; r++){
+            for(int c = 0; c < N; c++){
+                t.covariance[r][c] = covariance[r][c][i];
+            }
+        }
+        return t;
+    }
+
+    void setTrack(size_t i, const Track & t){
+        for(int a = 0; a < 3; a++){
+            for(int k = 0; k < N; k++){
+                state[a][k][i] = t.state[a][k];
+            }
+        }
+        for(int r = 0; r < N; r++){
+            for(int c = 0; c < N; c++){
+                covariance[r][c][i] = t.covariance[r][c];
+            }
+        }
+    }
+
+    // predict and correct every track with one measurement each
+    void update(const glm::vec3 * measurements){
+        const size_t count = size();
+
+        // transition matrix, a Taylor step: row r has 1 / (c - r)! from column r on
+        float F[N][N];
+        for(int r = 0; r < N; r++){
+            float term = 1;
+            for(int c = 0; c < N; c++){
+                if(c < r){
+                    F[r][c] = 0;
+                } else {
+                    F[r][c] = term;
+                    term /= float(c - r + 1);
+                }
+            }
+        }
+
+        for(size_t i = 0; i < count; i++){
+
+            // P = F P F' + Q
+            float P[N][N], FP[N][N];
+            for(int r = 0; r < N; r++){
+                for(int c = 0; c < N; c++){
+                    float sum = 0;
+                    for(int k = 0; k < N; k++){
+                        sum += F[r][k] * covariance[k][c][i];
+                    }
+                    FP[r][c] = sum;
+                }
+            }
+            for(int r = 0; r < N; r++){
+                for(int c = 0; c < N; c++){
+                    float sum = 0;
+                    for(int k = 0; k < N; k++){
+                        sum += FP[r][k] * F[c][k];
+                    }
+                    P[r][c] = sum + (r == c ? processNoise : 0.0f);
+                }
+            }
+
+            // gain for a position measurement
+            const float S = P[0][0] + measurementNoise;
+            float K[N];
+            for(int r = 0; r < N; r++){
+                K[r] = P[r][0] / S;
+            }
+
+            for(int a = 0; a < 3; a++){
+                // x = F x
+                float x[N];
+                for(int r = 0; r < N; r++){
+                    float sum = 0;
+                    for(int k = 0; k < N; k++){
+                        sum += F[r][k] * state[a][k][i];
+                    }
+                    x[r] = sum;
+                }
+                const float innovation = measurements[i][a] - x[0];
+                for(int r = 0; r < N; r++){
+                    state[a][r][i] = x[r] + K[r] * innovation;
+                }
+            }
+
+            // P = P - K H P
+            for(int r = 0; r < N; r++){
+                for(int c = 0; c < N; c++){
+                    covariance[r][c][i] = P[r][c] - K[r] * P[0][c];
+                }
+            }
+        }
+    }
+
+    glm::vec3 getEstimation(size_t i) const {
+        return glm::vec3(state[0][0][i], state[1][0][i], state[2][0][i]);
+    }
+
+private:
+    float processNoise = 0;
+    float measurementNoise = 0;
+
+    std::vector<float> state[3][N]; // per axis, per derivative, per track
+    std::vector<float> covariance[N][N]; // per track
+};
@@ -0,0 +1,125 @@
+//
+//  OneEuroFilter.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Speed adaptive low pass filter for a position (Casiez et al., the 1 euro
+// filter).
+//
+// A first order low pass whose cutoff rises with the filtered speed: standing
+// still it sits at minCutoff and removes jitter, moving it opens up by beta
+// per m/s so the lag stays small. Unlike the Kalman filters it takes the real
+// time between samples, so dropped depth frames do not change its behaviour.
+
+class OneEuroFilter {
+public:
+
+    struct Settings {
+        float minCutoff = 1.0; // Hz when standing still
+        float beta = 2.0; // Hz added per m/s
+        float derivativeCutoff = 1.0; // Hz, for the speed estimate
+    };
+
+    void setup(const Settings & settings){
+        this->settings = settings;
+    }
+
+    void reset(){
+        initialized = false;
+    }
+
+    // time in seconds, only needs to increase
+    glm::vec3 filter(const glm::vec3 & x, double time){
+        if(!initialized || time <= lastTime){
+            if(!initialized){
+                value = x;
+                derivative = glm::vec3(0);
+                initialized = true;
+            }
+            lastTime = time;
+            return value;
+        }
+        const float dt = time - lastTime;
+        lastTime = time;
+
+        // speed against the previous output, as in the reference implementation
+        const glm::vec3 rawDerivative = (x - value) / dt;
+        derivative += (rawDerivative - derivative) * alpha(settings.derivativeCutoff, dt);
+        const float cutoff = settings.minCutoff + settings.beta * glm::length(derivative);
+        value += (x - value) * alpha(cutoff, dt);
+        return value;
+    }
+
+    glm::vec3 getValue() const {
+        return value;
+    }
+
+private:
+
+    static float alpha(float cutoff, float dt){
+        const float tau = 1.0 / (2.0 * M_PI * cutoff);
+        return 1.0 / (1.0 + tau / dt);
+    }
+
+    Settings settings;
+    bool initialized = false;
+    double lastTime = 0;
+    glm::vec3 value;
+    glm::vec3 derivative;
+};
+
+// Measures how far a filtered position trails the raw one, in seconds.
+//
+// While moving, raw - filtered is about velocity * delay, so the delay is a
+// least squares fit of one against the other with older samples fading out.
+// Only x and z are used, walking is horizontal and the tracker adds a
+// vertical bias to its measurements.
+
+class SmoothingLag {
+public:
+
+    float minSpeed = 0.25; // m/s, slower samples are mostly noise
+    float decay = 0.97; // per sample
+
+    void reset(){
+        initialized = false;
+        sumProduct = 0;
+        sumSpeedSquared = 0;
+    }
+
+    void update(const glm::vec3 & raw, const glm::vec3 & filtered, double time){
+        if(initialized && time > lastTime){
+            const glm::vec2 velocity = glm::vec2(filtered.x - lastFiltered.x, filtered.z - lastFiltered.z) / float(time - lastTime);
+            const float speedSquared = glm::dot(velocity, velocity);
+            if(speedSquared > minSpeed * minSpeed){
+                const glm::vec2 lead(raw.x - filtered.x, raw.z - filtered.z);
+                sumProduct = sumProduct * decay + glm::dot(lead, velocity);
+                sumSpeedSquared = sumSpeedSquared * decay + speedSquared;
+            }
+        }
+        lastFiltered = filtered;
+        lastTime = time;
+        initialized = true;
+    }
+
+    bool isValid() const {
+        return sumSpeedSquared > 0;
+    }
+
+    float get() const {
+        return isValid() ? sumProduct / sumSpeedSquared : 0.0;
+    }
+
+private:
+    bool initialized = false;
+    double lastTime = 0;
+    glm::vec3 lastFiltered;
+    double sumProduct = 0;
+    double sumSpeedSquared = 0;
+};
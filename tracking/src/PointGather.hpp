@@ -0,0 +1,141 @@
+//
+//  PointGather.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <librealsense2/rs.h>
+#include <librealsense2/rsutil.h>
+#include <glm/glm.hpp>
+#include "DepthRayTable.hpp"
+#include "DepthBackground.hpp"
+#include "HeadTracker.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// Points as separate x, y and z arrays, the way HeadTracker::addVertices takes them,
+// and the depth each was measured at in its own sensor.
+
+struct PointSet {
+    std::vector<float> x, y, z, depth;
+    size_t count = 0;
+
+    void clear(){
+        count = 0;
+    }
+
+    // room for n more points
+    void reserve(size_t n){
+        if(x.size() < count + n){
+            x.resize(count + n);
+            y.resize(count + n);
+            z.resize(count + n);
+            depth.resize(count + n);
+        }
+    }
+};
+
+// appends the samples behind rays begin to end that are inside the box and in front of the background
+inline void gatherPoints(const DepthRayTable & table, size_t begin, size_t end, const uint16_t * depth, float depthScale, const DepthBackground * background, PointSet & out){
+    out.reserve(end - begin);
+    const glm::vec3 o = table.origin;
+    for(size_t i = begin; i < end; i++){
+        const uint32_t pixel = table.pixels[i];
+        const uint16_t raw = depth[pixel];
+        if(background && !background->isForeground(pixel, raw)) continue;
+        const float z = raw * depthScale;
+        if(z > table.zNear[i] && z < table.zFar[i]){
+            const glm::vec3 & d = table.directions[i];
+            out.x[out.count] = o.x + d.x * z;
+            out.y[out.count] = o.y + d.y * z;
+            out.z[out.count] = o.z + d.z * z;
+            out.depth[out.count] = z;
+            out.count++;
+        }
+    }
+}
+
+// Gathers only the pixels whose samples could reach a head: every head's
+// reach is projected into the image as a rectangle, and the rows of the
+// rectangles are looked up in the ray table as merged spans.
+
+class HeadRegionGather {
+public:
+
+    // outputToCamera takes the tracker's camera space into the one of the depth image
+    void gather(const HeadTracker & tracker, const DepthRayTable & rays, const rs2_intrinsics & intrinsics, const uint16_t * depth, float depthScale, const DepthBackground * background, const glm::mat4 & outputToCamera, PointSet & out){
+        updateRegions(tracker, intrinsics, outputToCamera);
+        const int width = intrinsics.width;
+        for(int y = 0; y < intrinsics.height; y++){
+            spans.clear();
+            for(auto & region : regions){
+                if(y >= region.y0 && y <= region.y1) spans.push_back({region.x0, region.x1});
+            }
+            if(spans.empty()) continue;
+            std::sort(spans.begin(), spans.end());
+            const uint32_t * rowBegin = rays.pixels.data() + rays.rowStart[y];
+            const uint32_t * rowEnd = rays.pixels.data() + rays.rowStart[y + 1];
+            int covered = -1;
+            for(auto & span : spans){
+                const int x0 = std::max(span.first, covered + 1);
+                if(x0 > span.second) continue;
+                covered = span.second;
+                const size_t begin = std::lower_bound(rowBegin, rowEnd, uint32_t(y * width + x0)) - rays.pixels.data();
+                const size_t end = std::upper_bound(rowBegin, rowEnd, uint32_t(y * width + span.second)) - rays.pixels.data();
+                gatherPoints(rays, begin, end, depth, depthScale, background, out);
+            }
+        }
+    }
+
+private:
+
+    struct Region {
+        int x0, y0, x1, y1; // inclusive
+    };
+
+    // pixel rectangles that cover every head's reach, the whole image if a head is too close to project
+    void updateRegions(const HeadTracker & tracker, const rs2_intrinsics & intrinsics, const glm::mat4 & outputToCamera){
+        regions.clear();
+        const float scale = glm::length(glm::vec3(outputToCamera[0]));
+        for(auto & head : tracker.heads){
+            const glm::vec3 position = glm::vec3(outputToCamera * glm::vec4(head.position, 1.0));
+            const float r = (tracker.getReach(head) + 0.01) * scale;
+            Region region {intrinsics.width, intrinsics.height, -1, -1};
+            bool projectable = true;
+            for(int corner = 0; corner < 8 && projectable; corner++){
+                // camera space to the rs2 convention, see DepthRayTable
+                float point[3] = {
+                    position.x + (corner & 1 ? r : -r),
+                    -(position.y + (corner & 2 ? r : -r)),
+                    -(position.z + (corner & 4 ? r : -r))
+                };
+                if(point[2] < 0.1){
+                    projectable = false;
+                    break;
+                }
+                float pixel[2];
+                rs2_project_point_to_pixel(pixel, &intrinsics, point);
+                region.x0 = std::min(region.x0, int(floorf(pixel[0])) - 1);
+                region.y0 = std::min(region.y0, int(floorf(pixel[1])) - 1);
+                region.x1 = std::max(region.x1, int(ceilf(pixel[0])) + 1);
+                region.y1 = std::max(region.y1, int(ceilf(pixel[1])) + 1);
+            }
+            if(!projectable){
+                region = {0, 0, intrinsics.width - 1, intrinsics.height - 1};
+            }
+            region.x0 = std::max(region.x0, 0);
+            region.y0 = std::max(region.y0, 0);
+            region.x1 = std::min(region.x1, intrinsics.width - 1);
+            region.y1 = std::min(region.y1, intrinsics.height - 1);
+            if(region.x0 <= region.x1 && region.y0 <= region.y1){
+                regions.push_back(region);
+            }
+        }
+    }
+
+    std::vector<Region> regions;
+    std::vector<std::pair<int, int>> spans;
+};
@@ -0,0 +1,160 @@
+//
+//  RawDepthFile.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <librealsense2/rs.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// RAW DEPTH FILES
+//
+// header, then frameCount fixed size frames of
+// RawDepthFrameHeader followed by width*height uint16 depth values
+
+struct RawDepthHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frameCount;
+    float depthScale;
+    float fps;
+    float ppx, ppy;
+    float fx, fy;
+    int32_t model;
+    float coeffs[5];
+};
+
+struct RawDepthFrameHeader {
+    double timestamp; // ms
+    uint64_t frameNumber;
+};
+
+static const char rawDepthMagic[8] = {'O','R','D','E','P','T','H','\0'};
+static const uint32_t rawDepthVersion = 1;
+
+// A raw depth file mapped into memory, frames are read in place.
+
+class RawDepthReader {
+public:
+
+    ~RawDepthReader(){
+        close();
+    }
+
+    // path as the file system sees it, see getError when this fails
+    bool open(const std::string & path){
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            error = "could not open " + path;
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0){
+            error = "could not stat " + path;
+            ::close(fd);
+            return false;
+        }
+        mappingSize = st.st_size;
+        if(mappingSize < sizeof(RawDepthHeader)){
+            error = path + " is too small";
+            ::close(fd);
+            return false;
+        }
+        mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(mapping == MAP_FAILED){
+            mapping = nullptr;
+            error = "could not map " + path;
+            return false;
+        }
+
+        memcpy(&header, mapping, sizeof(header));
+        if(memcmp(header.magic, rawDepthMagic, sizeof(rawDepthMagic)) != 0 || header.version != rawDepthVersion){
+            error = path + " is not a raw depth file";
+            close();
+            return false;
+        }
+        if(header.headerSize < sizeof(RawDepthHeader) || header.headerSize > mappingSize){
+            error = path + " has a broken header";
+            close();
+            return false;
+        }
+        frameSize = sizeof(RawDepthFrameHeader) + size_t(header.width) * header.height * sizeof(uint16_t);
+        // trust the file size over the header if recording was interrupted
+        frameCount = std::min<size_t>(header.frameCount, (mappingSize - header.headerSize) / frameSize);
+        if(frameCount == 0){
+            error = path + " has no frames";
+            close();
+            return false;
+        }
+        madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+
+        intrinsics.width = header.width;
+        intrinsics.height = header.height;
+        intrinsics.ppx = header.ppx;
+        intrinsics.ppy = header.ppy;
+        intrinsics.fx = header.fx;
+        intrinsics.fy = header.fy;
+        intrinsics.model = (rs2_distortion) header.model;
+        for(int i = 0; i < 5; i++) intrinsics.coeffs[i] = header.coeffs[i];
+        return true;
+    }
+
+    void close(){
+        if(mapping != nullptr){
+            munmap(mapping, mappingSize);
+            mapping = nullptr;
+        }
+        frameCount = 0;
+    }
+
+    bool isOpen() const {
+        return mapping != nullptr;
+    }
+
+    const std::string & getError() const {
+        return error;
+    }
+
+    const RawDepthHeader & getHeader() const {
+        return header;
+    }
+
+    const rs2_intrinsics & getIntrinsics() const {
+        return intrinsics;
+    }
+
+    uint32_t getFrameCount() const {
+        return frameCount;
+    }
+
+    // the depth values follow the header, valid as long as the file is open
+    const RawDepthFrameHeader * getFrame(uint32_t index) const {
+        return (const RawDepthFrameHeader*)((const uint8_t*)mapping + header.headerSize + size_t(index) * frameSize);
+    }
+
+    static const uint16_t * getDepth(const RawDepthFrameHeader * frame){
+        return (const uint16_t*)(frame + 1);
+    }
+
+private:
+    void * mapping = nullptr;
+    size_t mappingSize = 0;
+    RawDepthHeader header;
+    rs2_intrinsics intrinsics;
+    size_t frameSize = 0;
+    uint32_t frameCount = 0;
+    std::string error;
+};
@@ -0,0 +1,76 @@
+//
+//  VoxelHash.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Hashed voxel grid that remembers which heads overlap each cell.
+//
+// Heads mark the cells covered by the bounding boxes of their spheres and
+// floor lines, points then look up the bitmask of heads they can possibly
+// belong to. Cells that collide in the table share a mask, which only ever
+// adds candidates, so a point is never hidden from a head that could claim it.
+
+class VoxelHash {
+public:
+
+    void setup(float cellSize, int tableBits = 14){
+        this->cellSize = cellSize;
+        inverseCellSize = 1.0 / cellSize;
+        tableMask = (1u << tableBits) - 1;
+        masks.assign(tableMask + 1, 0);
+        touched.clear();
+    }
+
+    float getCellSize() const {
+        return cellSize;
+    }
+
+    void clear(){
+        for(auto cell : touched){
+            masks[cell] = 0;
+        }
+        touched.clear();
+    }
+
+    // or bits into every cell overlapping the box from min to max
+    void mark(float minX, float minY, float minZ, float maxX, float maxY, float maxZ, uint32_t bits){
+        int x0 = cell(minX), x1 = cell(maxX);
+        int y0 = cell(minY), y1 = cell(maxY);
+        int z0 = cell(minZ), z1 = cell(maxZ);
+        for(int z = z0; z <= z1; z++){
+            for(int y = y0; y <= y1; y++){
+                for(int x = x0; x <= x1; x++){
+                    uint32_t h = hash(x, y, z);
+                    if(masks[h] == 0) touched.push_back(h);
+                    masks[h] |= bits;
+                }
+            }
+        }
+    }
+
+    uint32_t lookup(float x, float y, float z) const {
+        return masks[hash(cell(x), cell(y), cell(z))];
+    }
+
+private:
+
+    int cell(float v) const {
+        return int(floorf(v * inverseCellSize));
+    }
+
+    uint32_t hash(int x, int y, int z) const {
+        return ((uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u) ^ (uint32_t(z) * 83492791u)) & tableMask;
+    }
+
+    float cellSize = 1.0;
+    float inverseCellSize = 1.0;
+    uint32_t tableMask = 0;
+    std::vector<uint32_t> masks;
+    std::vector<uint32_t> touched;
+};
@@ -0,0 +1,123 @@
+//
+//  WorkerPool.hpp
+//  tracking
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run numbered jobs.
+//
+// parallelFor hands out job indices to the workers and to the calling thread
+// and returns once all of them are done. Jobs are picked up in any order on
+// any thread, so results that must be reproducible should be written per job
+// index and combined by the caller afterwards.
+
+class WorkerPool {
+public:
+
+    ~WorkerPool(){
+        stop();
+    }
+
+    // threads in addition to the calling thread, defaults to one per spare core
+    void setup(int numThreads = -1){
+        stop();
+        if(numThreads < 0){
+            numThreads = std::max(0, int(std::thread::hardware_concurrency()) - 1);
+        }
+        stopping = false;
+        for(int i = 0; i < numThreads; i++){
+            threads.emplace_back(&WorkerPool::work, this);
+        }
+    }
+
+    void stop(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto & thread : threads){
+            thread.join();
+        }
+        threads.clear();
+    }
+
+    size_t getNumThreads() const {
+        return threads.size();
+    }
+
+    // runs job(0) to job(count - 1) and waits for all of them
+    void parallelFor(size_t count, const std::function<void(size_t)> & job){
+        if(count == 0) return;
+        if(threads.empty() || count == 1){
+            for(size_t i = 0; i < count; i++){
+                job(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->job = &job;
+            jobCount = count;
+            nextJob = 0;
+            pending = threads.size();
+            generation++;
+        }
+        wake.notify_all();
+        runJobs(job, count);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]{ return pending == 0; });
+        this->job = nullptr;
+    }
+
+private:
+
+    void work(){
+        unsigned long long seen = 0;
+        while(true){
+            const std::function<void(size_t)> * currentJob;
+            size_t count;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]{ return stopping || generation != seen; });
+                if(stopping) return;
+                seen = generation;
+                currentJob = job;
+                count = jobCount;
+            }
+            runJobs(*currentJob, count);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(--pending == 0) done.notify_one();
+            }
+        }
+    }
+
+    void runJobs(const std::function<void(size_t)> & job, size_t count){
+        size_t i;
+        while((i = nextJob.fetch_add(1)) < count){
+            job(i);
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const std::function<void(size_t)> * job = nullptr;
+    size_t jobCount = 0;
+    std::atomic<size_t> nextJob {0};
+    size_t pending = 0;
+    unsigned long long generation = 0;
+    bool stopping = false;
+};